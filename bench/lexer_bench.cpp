@@ -0,0 +1,154 @@
+// keyword recognition on identifier-dense input: the old hash map lookup
+// against keywordType's switch, on the words alone and inside the whole
+// lexer. then the parallel lexer at 1, 2, 4... threads up to max-threads
+// (one per core by default), each run checked against the serial tokens.
+//
+//   zenith_lexer_bench [megabytes] [passes] [max-threads]
+
+#include "interpreter/lexer/keywords.h"
+#include "interpreter/lexer/lexer.h"
+#include "interpreter/lexer/parallel_lexer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// what Lexer::identifier used to probe
+const std::unordered_map<std::string_view, TokenType>& keywordMap() {
+    static const std::unordered_map<std::string_view, TokenType> map = [] {
+        std::unordered_map<std::string_view, TokenType> m;
+        for (const Keyword& k : KEYWORDS) m.emplace(k.text, k.type);
+        return m;
+    }();
+    return map;
+}
+
+TokenType lookupMap(std::string_view text) {
+    auto it = keywordMap().find(text);
+    return it != keywordMap().end() ? it->second : IDENTIFIER;
+}
+
+// declarations and conditions with short names, about a third keywords.
+// plenty of names share a length and first letter with a keyword
+std::string generate(size_t bytes) {
+    static const char* names[] = {"i", "index", "total", "flag", "item", "value", "count",
+                                  "fo", "thing", "wide", "sum", "name", "row", "strings"};
+    std::string source;
+    source.reserve(bytes + 128);
+    for (size_t i = 0; source.size() < bytes; i++) {
+        const char* a = names[i % 14];
+        const char* b = names[(i * 7 + 3) % 14];
+        source += "int ";  source += a; source += " = "; source += b; source += ";\n";
+        source += "while ("; source += a; source += " and "; source += b;
+        source += " or true) { display("; source += a; source += "); }\n";
+        source += "if ("; source += b; source += " == null) { bool "; source += a;
+        source += " = false; } else { string "; source += b; source += " = "; source += a; source += "; }\n";
+    }
+    return source;
+}
+
+std::vector<std::string_view> words(const std::string& source) {
+    std::vector<std::string_view> out;
+    for (size_t i = 0; i < source.size();) {
+        char c = source[i];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            size_t start = i;
+            while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) i++;
+            out.push_back(std::string_view(source).substr(start, i - start));
+        } else {
+            i++;
+        }
+    }
+    return out;
+}
+
+template <typename F>
+double bestOf(int passes, F&& run) {
+    double best = 1e300;
+    for (int pass = 0; pass < passes; pass++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+template <typename Lookup>
+double classify(const std::vector<std::string_view>& list, int passes, Lookup lookup) {
+    size_t keywords = 0;
+    double best = bestOf(passes, [&] {
+        for (std::string_view w : list) keywords += lookup(w) != IDENTIFIER;
+    });
+    if (keywords == 42) std::puts(""); // keep the lookups alive
+    return best * 1e9 / static_cast<double>(list.size());
+}
+
+// same tokens, same symbols, same interned text in the same order
+bool sameTokens(const std::vector<Token>& a, const Interner& ia,
+                const std::vector<std::vector<Token>>& pieces, const Interner& ib) {
+    std::vector<Token> b;
+    for (const auto& piece : pieces) b.insert(b.end(), piece.begin(), piece.end());
+    if (a.size() != b.size() || ia.size() != ib.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].lexeme != b[i].lexeme || a[i].line != b[i].line
+            || a[i].symbol != b[i].symbol)
+            return false;
+    }
+    for (Symbol s = 0; s < ia.size(); s++) {
+        if (ia.text(s) != ib.text(s)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    int passes = argc > 2 ? std::atoi(argv[2]) : 10;
+    unsigned maxThreads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3]))
+                                   : std::max(1u, std::thread::hardware_concurrency());
+
+    std::string source = generate(megabytes * 1024 * 1024);
+    std::vector<std::string_view> list = words(source);
+    double mb = source.size() / (1024.0 * 1024.0);
+
+    std::printf("%.1f MB source, %zu words, best of %d\n\n", mb, list.size(), passes);
+    std::printf("unordered_map  %6.2f ns/word\n", classify(list, passes, lookupMap));
+    std::printf("keywordType    %6.2f ns/word\n", classify(list, passes, keywordType));
+
+    double lexing = bestOf(passes, [&] {
+        Interner interner;
+        Lexer lexer(source, interner);
+        while (lexer.scanToken().type != END_OF_FILE) {}
+    });
+    std::printf("\nlexer          %6.1f MB/s\n", mb / lexing);
+
+    Interner serialInterner;
+    std::vector<Token> serial = Lexer(source, serialInterner).scanTokens();
+    double scanning = bestOf(passes, [&] {
+        Interner interner;
+        Lexer(source, interner).scanTokens();
+    });
+    std::printf("scanTokens     %6.1f MB/s\n\n", mb / scanning);
+
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        double best = bestOf(passes, [&] {
+            Interner interner;
+            scanTokensParallel(source, interner, threads);
+        });
+        Interner interner;
+        bool same = sameTokens(serial, serialInterner, scanTokensParallel(source, interner, threads), interner);
+        std::printf("%2u threads     %6.1f MB/s  %s\n", threads, mb / best, same ? "same tokens" : "TOKENS DIFFER");
+        if (!same) return 1;
+    }
+    return 0;
+}
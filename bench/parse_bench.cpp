@@ -0,0 +1,110 @@
+// lexing + parsing throughput on a big generated script, and the most heap
+// the two had live at once while doing it. lexing on its own is timed too.
+//
+//   zenith_parse_bench [megabytes] [passes]
+
+#include "interpreter/lexer/lexer.h"
+#include "interpreter/parser/parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// same counting allocator as the value bench, plus a high water mark
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+static constexpr size_t HEADER = alignof(std::max_align_t);
+
+void* operator new(size_t size) {
+    liveBytes += size;
+    peakBytes = std::max(peakBytes, liveBytes);
+    if (auto* p = static_cast<char*>(std::malloc(size + HEADER))) {
+        *reinterpret_cast<size_t*>(p) = size;
+        return p + HEADER;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    char* block = static_cast<char*>(p) - HEADER;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+// a mix of what generated scripts look like: declarations, arithmetic,
+// conditionals, loops, strings and comments
+std::string generate(size_t bytes) {
+    std::string source;
+    source.reserve(bytes + 256);
+    for (size_t i = 0; source.size() < bytes; i++) {
+        std::string n = std::to_string(i);
+        source += "int v" + n + " = " + n + " * (v" + n + " + 3) - 7 / 2;\n";
+        source += "string s" + n + " = \"some text for row " + n + "\";\n";
+        source += "if (v" + n + " >= 10 and !false) {\n    display(s" + n + ");\n} else {\n"
+                  "    v" + n + " = v" + n + " - 1;\n}\n";
+        source += "// a comment about row " + n + "\n";
+        source += "for (j = 0; j < 3; j = j + 1) { display(j == 2 or v" + n + " != 0); }\n";
+    }
+    return source;
+}
+
+size_t parse(const std::string& source) {
+    Interner interner;
+    Lexer lexer(source, interner);
+    TokenStream tokens(lexer);
+    Parser parser(tokens, interner);
+    Ast ast = parser.parse();
+    return ast.statements.size();
+}
+
+size_t lex(const std::string& source) {
+    Interner interner;
+    Lexer lexer(source, interner);
+    size_t count = 1;
+    while (lexer.scanToken().type != END_OF_FILE) count++;
+    return count;
+}
+
+template <typename F>
+double bestOf(int passes, F&& run) {
+    double best = 1e300;
+    for (int pass = 0; pass < passes; pass++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    int passes = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::string source = generate(megabytes * 1024 * 1024);
+    double mb = source.size() / (1024.0 * 1024.0);
+
+    // warm up the allocator and caches, then take the best pass
+    size_t statements = parse(source);
+    size_t tokens = lex(source);
+    double lexing = bestOf(passes, [&] { lex(source); });
+
+    size_t baseline = liveBytes;
+    peakBytes = liveBytes;
+    double parsing = bestOf(passes, [&] { parse(source); });
+
+    std::printf("%.1f MB source, %zu tokens, %zu top level statements, best of %d\n",
+                mb, tokens, statements, passes);
+    std::printf("lex only      %8.1f MB/s\n", mb / lexing);
+    std::printf("lex + parse   %8.1f MB/s\n", mb / parsing);
+    std::printf("peak heap     %8.1f MB\n", (peakBytes - baseline) / (1024.0 * 1024.0));
+    return 0;
+}
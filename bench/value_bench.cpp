@@ -0,0 +1,122 @@
+// compares the old std::variant Value against the compact one: how much
+// memory a slot array takes, and how fast (and allocation free) copying
+// values out of it is, which is what every variable read does.
+//
+//   zenith_value_bench [slots] [passes]
+
+#include "interpreter/value.h"
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <variant>
+#include <vector>
+
+using OldValue = std::variant<int, bool, std::string, char, std::monostate>;
+
+// count every heap allocation the process makes, and how many bytes are live.
+// each block carries its size in a header so frees can be subtracted
+static size_t allocations = 0;
+static size_t liveBytes = 0;
+static constexpr size_t HEADER = alignof(std::max_align_t);
+
+void* operator new(size_t size) {
+    allocations++;
+    liveBytes += size;
+    if (auto* p = static_cast<char*>(std::malloc(size + HEADER))) {
+        *reinterpret_cast<size_t*>(p) = size;
+        return p + HEADER;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    char* block = static_cast<char*>(p) - HEADER;
+    liveBytes -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+// half ints, a quarter short strings, a quarter strings too long to inline
+std::string textFor(size_t i) {
+    if (i % 4 == 1) return "name" + std::to_string(i % 1000);
+    return "a somewhat longer string value #" + std::to_string(i);
+}
+
+OldValue makeOld(size_t i) {
+    if (i % 2 == 0) return static_cast<int>(i);
+    return textFor(i);
+}
+
+Value makeNew(size_t i) {
+    if (i % 2 == 0) return static_cast<int>(i);
+    return Value::string(textFor(i));
+}
+
+size_t weigh(const OldValue& v) {
+    return std::holds_alternative<std::string>(v) ? std::get<std::string>(v).size() : 1;
+}
+
+size_t weigh(const Value& v) {
+    return v.isString() ? v.asString().size() : 1;
+}
+
+struct Result {
+    size_t footprint;   // slot array plus whatever the slots point at
+    double nsPerRead;
+    size_t readAllocations;
+};
+
+template <typename V, typename Make>
+Result measure(size_t slots, int passes, Make make) {
+    size_t bytesBefore = liveBytes;
+    std::vector<V> env;
+    env.reserve(slots);
+    for (size_t i = 0; i < slots; i++) env.push_back(make(i));
+    size_t footprint = liveBytes - bytesBefore;
+
+    // copy every slot out, like Environment reads used to
+    size_t sink = 0;
+    size_t allocsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < slots; i++) {
+            V copy = env[i];
+            sink += weigh(copy);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    size_t readAllocations = allocations - allocsBefore;
+
+    if (sink == 42) std::puts(""); // keep the reads alive
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return {footprint, ns / (static_cast<double>(slots) * passes), readAllocations};
+}
+
+void report(const char* name, size_t size, const Result& r) {
+    std::printf("%-16s %6zu B %12.1f MB %10.2f ns %14zu\n",
+                name, size, r.footprint / (1024.0 * 1024.0), r.nsPerRead, r.readAllocations);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t slots = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int passes = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::printf("%zu slots, %d read passes\n\n", slots, passes);
+    std::printf("%-16s %8s %15s %13s %14s\n", "", "sizeof", "footprint", "per read", "read allocs");
+
+    Result old = measure<OldValue>(slots, passes, makeOld);
+    report("std::variant", sizeof(OldValue), old);
+
+    Result compact = measure<Value>(slots, passes, makeNew);
+    report("Value", sizeof(Value), compact);
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+// times every phase of the pipeline on its own over a corpus of .zen
+// workloads, so a slowdown can be pinned on the lexer, the parser or the
+// engine that runs the result. results come out as JSON to keep around and
+// compare between releases.
+//
+//   zenith_bench [--reps=N] [--warmup=N] [--generated-mb=N] [--no-jit] [--out=file] [file.zen | dir]...
+//
+// --no-jit times the vm interpreting every loop, hot or not (jit.h).
+// with no files it runs bench/corpus plus one large generated script.
+// display output goes to /dev/null. a workload with an error stops the bench
+// like it would stop zenith.
+
+#include "interpreter/lexer/lexer.h"
+#include "interpreter/lexer/token_stream.h"
+#include "interpreter/parser/parser.h"
+#include "interpreter/resolver/resolver.h"
+#include "interpreter/checker/checker.h"
+#include "interpreter/folder/folder.h"
+#include "interpreter/evaluator/evaluator.h"
+#include "interpreter/compiler/compiler.h"
+#include "interpreter/vm/vm.h"
+#include "interpreter/output.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef ZENITH_VERSION
+#define ZENITH_VERSION "unknown"
+#endif
+#ifndef ZENITH_BENCH_CORPUS
+#define ZENITH_BENCH_CORPUS "bench/corpus"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum Phase { LEX, PARSE, RESOLVE, CHECK, FOLD, EVALUATE, COMPILE, VM_RUN, PHASE_COUNT };
+const char* PHASE_NAMES[PHASE_COUNT] = {"lex", "parse", "resolve", "check", "fold", "evaluate", "compile", "vm"};
+
+struct Workload {
+    std::string name;
+    std::string source;
+};
+
+// nanoseconds per repetition, one list per phase
+using Samples = std::array<std::vector<double>, PHASE_COUNT>;
+
+template <typename F>
+double timed(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// the whole pipeline once, each phase timed separately. the tree walker and
+// the vm both run the same folded ast
+void runOnce(const std::string& source, Output& sink, bool useJit, Samples* samples) {
+    double t[PHASE_COUNT];
+    Interner interner;
+
+    std::vector<Token> tokens;
+    t[LEX] = timed([&] {
+        Lexer lexer(source, interner);
+        tokens = lexer.scanTokens();
+    });
+
+    Ast ast;
+    t[PARSE] = timed([&] {
+        TokenStream stream(tokens);
+        ast = Parser(stream, interner).parse();
+    });
+
+    int globals = 0;
+    t[RESOLVE] = timed([&] { globals = Resolver().resolve(ast); });
+    t[CHECK] = timed([&] { Checker().check(ast, globals); });
+    t[FOLD] = timed([&] { Folder(interner).fold(ast); });
+
+    t[EVALUATE] = timed([&] {
+        Evaluator(sink).run(ast, globals);
+        sink.flush();
+    });
+
+    Chunk chunk;
+    t[COMPILE] = timed([&] { chunk = Compiler().compile(ast, globals); });
+    t[VM_RUN] = timed([&] {
+        VM vm(sink);
+        vm.setJit(useJit);
+        vm.run(chunk);
+        sink.flush();
+    });
+
+    if (samples) {
+        for (int p = 0; p < PHASE_COUNT; p++) (*samples)[p].push_back(t[p]);
+    }
+}
+
+// lots of distinct globals, arithmetic, branches and strings, the way
+// machine generated scripts tend to look
+std::string generate(size_t bytes) {
+    std::string source = "// generated\n";
+    source.reserve(bytes + 256);
+    for (size_t i = 0; source.size() < bytes; i++) {
+        std::string n = std::to_string(i);
+        std::string g = "g" + n;
+        source += "int " + g + " = " + n + " * 3 + " + std::to_string(i % 7) + ";\n";
+        source += "if (" + g + " > " + n + " and " + g + " - " + g + " / 2 * 2 == 0) { " +
+                  g + " = " + g + " / 2; } else { " + g + " = " + g + " + 1; }\n";
+        source += "string s" + n + " = \"row " + n + "\" + \"!\";\n";
+    }
+    return source;
+}
+
+bool readFile(const fs::path& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+void addPath(const fs::path& path, std::vector<Workload>& workloads) {
+    if (fs::is_directory(path)) {
+        std::vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(path)) {
+            if (entry.path().extension() == ".zen") files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+        for (const auto& file : files) addPath(file, workloads);
+        return;
+    }
+    Workload w{path.stem().string(), ""};
+    if (!readFile(path, w.source)) {
+        std::cerr << "[ERROR] Could not open file '" << path.string() << "'\n";
+        std::exit(1);
+    }
+    workloads.push_back(std::move(w));
+}
+
+struct Stats {
+    double min, median, mean;
+};
+
+Stats summarize(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (double x : v) sum += x;
+    size_t mid = v.size() / 2;
+    double median = v.size() % 2 ? v[mid] : (v[mid - 1] + v[mid]) / 2;
+    return {v.front(), median, sum / static_cast<double>(v.size())};
+}
+
+std::string jsonString(std::string_view text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        out += c;
+    }
+    return out + "\"";
+}
+
+int intArg(std::string_view arg, std::string_view flag) {
+    return std::atoi(std::string(arg.substr(flag.size())).c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int reps = 10;
+    int warmup = 2;
+    int generatedMb = 4;
+    bool useJit = true;
+    std::string outPath;
+    std::vector<Workload> workloads;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.rfind("--reps=", 0) == 0) reps = std::max(1, intArg(arg, "--reps="));
+        else if (arg.rfind("--warmup=", 0) == 0) warmup = std::max(0, intArg(arg, "--warmup="));
+        else if (arg.rfind("--generated-mb=", 0) == 0) generatedMb = intArg(arg, "--generated-mb=");
+        else if (arg.rfind("--out=", 0) == 0) outPath = std::string(arg.substr(6));
+        else if (arg == "--no-jit") useJit = false;
+        else if (arg.substr(0, 2) == "--") {
+            std::cerr << "Usage: zenith_bench [--reps=N] [--warmup=N] [--generated-mb=N] "
+                         "[--no-jit] [--out=file] [file.zen | dir]...\n";
+            return 1;
+        }
+        else addPath(argv[i], workloads);
+    }
+    if (workloads.empty()) {
+        addPath(ZENITH_BENCH_CORPUS, workloads);
+        if (generatedMb > 0) {
+            workloads.push_back({"generated_" + std::to_string(generatedMb) + "mb",
+                                 generate(static_cast<size_t>(generatedMb) * 1024 * 1024)});
+        }
+    }
+
+#ifdef _WIN32
+    int nullFd = open("NUL", O_WRONLY);
+#else
+    int nullFd = open("/dev/null", O_WRONLY);
+#endif
+    Output sink(nullFd, Output::FlushPolicy::Block);
+
+    std::ostringstream json;
+    json << "{\n  \"zenith_version\": " << jsonString(ZENITH_VERSION)
+         << ",\n  \"repetitions\": " << reps << ",\n  \"warmup\": " << warmup
+         << ",\n  \"unit\": \"ns\",\n  \"workloads\": [";
+
+    for (size_t w = 0; w < workloads.size(); w++) {
+        const Workload& work = workloads[w];
+        std::cerr << "running " << work.name << "\n";
+
+        for (int i = 0; i < warmup; i++) runOnce(work.source, sink, useJit, nullptr);
+        Samples samples;
+        for (int i = 0; i < reps; i++) runOnce(work.source, sink, useJit, &samples);
+
+        json << (w ? "," : "") << "\n    {\n      \"name\": " << jsonString(work.name)
+             << ",\n      \"bytes\": " << work.source.size() << ",\n      \"phases\": {";
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            Stats s = summarize(samples[p]);
+            char line[160];
+            std::snprintf(line, sizeof(line),
+                          "%s\n        \"%s\": {\"min\": %.0f, \"median\": %.0f, \"mean\": %.0f}",
+                          p ? "," : "", PHASE_NAMES[p], s.min, s.median, s.mean);
+            json << line;
+        }
+        json << "\n      }\n    }";
+    }
+    json << "\n  ]\n}\n";
+
+    if (outPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(outPath);
+        if (!out) {
+            std::cerr << "[ERROR] Could not write '" << outPath << "'\n";
+            return 1;
+        }
+        out << json.str();
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef ZENITH_H
+#define ZENITH_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// libzenith, for running zenith scripts inside another program.
+//
+// compile a script once, then run it as often as you like:
+//
+//   zenith::Program rule = zenith::compile(source, {"amount", "country"});
+//   if (!rule.ok()) fail(rule.error());
+//
+//   zenith::Context request;
+//   request.set("amount", 250);
+//   request.set("country", std::string("NZ"));
+//   request.onOutput([&](std::string_view text) { log.append(text); });
+//   zenith::Result result = zenith::run(rule, request);
+//
+// a Program never changes once it's compiled, any number of threads can run
+// the same one at once, each with its own Context. nothing here prints or
+// exits, errors come back as the same text the command line would print.
+namespace zenith {
+
+// a script value as the host sees it. null is std::monostate
+using Variable = std::variant<std::monostate, int, bool, char, std::string>;
+
+class Program;
+
+struct Result {
+    bool ok = true;
+    // the error report when !ok, one line per error, each ending in a newline
+    std::string error;
+};
+
+// one run's worth of state: the host variables going in (and coming back
+// out) and where display goes. reusable across runs, not shareable between
+// threads running at the same time
+class Context {
+    public:
+        // gives a host variable its value for the next run. names the
+        // program wasn't compiled with are ignored, unset ones start as null
+        void set(const std::string& name, Variable value) { variables[name] = std::move(value); }
+        // after a successful run, what the script left in the variable
+        const Variable& get(const std::string& name) const;
+
+        // display hands its text here, in chunks that don't necessarily end
+        // on a line. everything is handed over before run returns.
+        // without one, output goes to stdout
+        void onOutput(std::function<void(std::string_view)> callback) { output = std::move(callback); }
+
+        // run checks the flag on every trip round a loop, and once it's set
+        // the script stops with an error. it can be set from any thread, to
+        // give up on a script that has run too long. it has to outlive the run
+        void interruptOn(const std::atomic<bool>* flag) { interrupt = flag; }
+
+    private:
+        std::map<std::string, Variable> variables;
+        std::function<void(std::string_view)> output;
+        const std::atomic<bool>* interrupt = nullptr;
+
+        friend Result run(const Program& program, Context& context);
+};
+
+// hostVariables are names the script can use without declaring them, filled
+// in from the Context on every run
+Program compile(std::string_view source, const std::vector<std::string>& hostVariables = {});
+
+Result run(const Program& program, Context& context);
+
+class Program {
+    public:
+        // false if the script didn't compile, run() then just hands error() back
+        bool ok() const { return compiled != nullptr; }
+        const std::string& error() const { return report; }
+
+    private:
+        struct Compiled;
+        std::shared_ptr<const Compiled> compiled;
+        std::string report;
+
+        friend Program compile(std::string_view source, const std::vector<std::string>& hostVariables);
+        friend Result run(const Program& program, Context& context);
+};
+
+} // namespace zenith
+
+#endif
@@ -0,0 +1,459 @@
+#include "cache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifndef ZENITH_VERSION
+#define ZENITH_VERSION "dev"
+#endif
+
+// .zenc layout, everything in host byte order:
+//
+//   Header
+//   code        codeSize bytes, padded to 8
+//   lines       lineCount LineStart entries, padded to 8
+//   constants   constantCount Constant entries
+//   strings     [u32 length][text], each padded to 4
+//
+// sections are found through the header's offsets, never by walking
+
+namespace {
+
+// bump whenever the layout below or the meaning of any opcode changes
+constexpr uint32_t FORMAT = 3;
+constexpr char MAGIC[4] = {'Z', 'E', 'N', 'C'};
+constexpr uint32_t ENDIAN_MARK = 0x01020304;
+
+// past this, store() deletes the entries used longest ago
+constexpr uint64_t MAX_CACHE_BYTES = 256ull << 20;
+// a temp file this old is from a store that died before its rename
+constexpr time_t ABANDONED_SECONDS = 3600;
+
+struct Header {
+    char magic[4];
+    uint32_t format;
+    char version[16];       // the interpreter that wrote it, nul padded
+    uint32_t opcodes;       // OP_COUNT_, in case someone forgets to bump FORMAT
+    uint32_t byteOrder;
+    uint64_t key[2];        // hash of the source
+    uint64_t sourceSize;
+    uint64_t checksum;      // hash of everything after the header
+    uint32_t codeOffset, codeSize;
+    uint32_t linesOffset, lineCount;
+    uint32_t constantsOffset, constantCount;
+    int32_t maxStack, maxLocals;
+};
+
+struct Constant {
+    uint8_t type;           // ValueType
+    uint8_t pad[3];
+    uint32_t symbol;        // strings, NO_SYMBOL unless it was interned
+    uint32_t payload;       // int/bool/char, or where a string's text starts
+    uint32_t length;        // strings
+};
+
+static_assert(sizeof(Header) % 8 == 0 && sizeof(Constant) == 16, "keep the sections aligned");
+static_assert(sizeof(LineStart) == 8, "the line table is mapped as is");
+
+uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+void versionField(char (&field)[16]) {
+    std::memset(field, 0, sizeof(field));
+    std::strncpy(field, ZENITH_VERSION, sizeof(field) - 1);
+}
+
+// the vm, its unchecked ops and the jit take every operand as given, so
+// they're checked once here: the opcodes exist, every instruction ends
+// inside the code, slots are in the frame, constants in the table, jumps
+// land on an instruction, and fused compares name a comparison. operand
+// types and stack depths aren't, those are trusted like the directory is
+bool validCode(const uint8_t* code, uint32_t size, uint32_t constantCount, int32_t maxLocals) {
+    auto slot = [&](const uint8_t* at) { return readOperand(at) < static_cast<uint32_t>(maxLocals); };
+    auto constant = [&](const uint8_t* at) { return readOperand(at) < constantCount; };
+    auto comparison = [](uint8_t cmp) {
+        return (cmp >= OP_GREATER && cmp <= OP_NOT_EQUAL) || (cmp >= OP_GREATER_INT && cmp <= OP_LESS_EQUAL_INT);
+    };
+
+    // one bit per code byte, set where an instruction starts
+    std::vector<uint64_t> starts(size / 64 + 1, 0);
+    std::vector<uint32_t> targets;
+    uint8_t last = OP_COUNT_; // empty code has no OP_HALT either
+    uint32_t length = 0;
+    for (uint32_t o = 0; o < size; o += length) {
+        last = code[o];
+        length = static_cast<uint32_t>(instructionSize(last));
+        if (last >= OP_COUNT_ || length > size - o) return false;
+        starts[o / 64] |= uint64_t(1) << (o % 64);
+        const uint8_t* at = code + o + 1;
+        bool ok = true;
+        switch (last) {
+            case OP_CONSTANT:
+                ok = constant(at);
+                break;
+            case OP_DEFINE_LOCAL: case OP_STORE_LOCAL: case OP_GET_LOCAL: case OP_SET_LOCAL:
+                ok = slot(at);
+                break;
+            case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+                targets.push_back(readOperand(at));
+                break;
+            case OP_LOOP:
+                targets.push_back(readOperand(at));
+                // the jit sizes its tables by the loop number
+                ok = readOperand(at + 4) < size;
+                break;
+            case OP_ADD_LOCAL_CONST:
+                ok = slot(at) && constant(at + 4);
+                break;
+            case OP_COMPARE_JUMP:
+                ok = comparison(at[0]);
+                targets.push_back(readOperand(at + 1));
+                break;
+            case OP_LOCAL_CONST_COMPARE_JUMP:
+                ok = comparison(at[0]) && slot(at + 1) && constant(at + 5);
+                targets.push_back(readOperand(at + 9));
+                break;
+            case OP_LOCALS_COMPARE_JUMP:
+                ok = comparison(at[0]) && slot(at + 1) && slot(at + 5);
+                targets.push_back(readOperand(at + 9));
+                break;
+            default:
+                break;
+        }
+        if (!ok) return false;
+    }
+    if (last != OP_HALT) return false;
+    for (uint32_t target : targets) {
+        if (target >= size || !(starts[target / 64] >> (target % 64) & 1)) return false;
+    }
+    return true;
+}
+
+size_t padTo(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+template <typename T>
+void append(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+// mkdir -p
+bool makeDirs(const std::string& dir) {
+#ifndef _WIN32
+    for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+        std::string prefix = dir.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (slash == std::string::npos) return true;
+    }
+#else
+    (void)dir;
+    return false;
+#endif
+}
+
+} // namespace
+
+// eight bytes a step
+uint64_t hashBytes(const char* p, size_t n, uint64_t seed) {
+    const uint64_t K1 = 0x9e3779b97f4a7c15ull, K2 = 0xc2b2ae3d27d4eb4full;
+    uint64_t h = seed ^ (n * K1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = rotl(h ^ (w * K2), 31) * K1;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, n - i);
+    h = rotl(h ^ (tail * K2), 31) * K1;
+
+    // murmur3's finaliser
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+ProgramCache::ProgramCache(std::string dir, std::string_view source)
+    : dir(std::move(dir)), source(source) {
+    // no dir, no cache. don't bother hashing
+    if (!this->dir.empty()) {
+        // the version and format are part of the key, so zeniths sharing a
+        // directory each keep their own entries instead of overwriting the
+        // other's every run
+        uint64_t seed = hashBytes(ZENITH_VERSION, std::strlen(ZENITH_VERSION),
+                                  uint64_t(FORMAT) << 32 | OP_COUNT_);
+        key[0] = hashBytes(source.data(), source.size(), seed);
+        key[1] = hashBytes(source.data(), source.size(), key[0] ^ 0x5a454e4954480000ull);
+
+        char name[40];
+        std::snprintf(name, sizeof(name), "%016llx%016llx.zenc",
+                      static_cast<unsigned long long>(key[0]),
+                      static_cast<unsigned long long>(key[1]));
+        entry = this->dir + "/" + name;
+    }
+}
+
+ProgramCache::~ProgramCache() {
+    constants.clear();
+#ifndef _WIN32
+    if (mapping) munmap(mapping, mappingSize);
+#endif
+}
+
+std::string ProgramCache::defaultDir() {
+    if (const char* dir = std::getenv("ZENITH_CACHE_DIR")) return dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+        return std::string(xdg) + "/zenith";
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return std::string(home) + "/.cache/zenith";
+    return "";
+}
+
+bool ProgramCache::load() {
+#ifndef _WIN32
+    if (entry.empty()) return false;
+
+    int fd = open(entry.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)
+        || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    mappingSize = static_cast<size_t>(info.st_size);
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mtime is when it was last used, prune() goes by it. an entry
+    // that turns out to be bad gets written over anyway
+    futimens(fd, nullptr);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        return false;
+    }
+
+    if (!check(static_cast<const char*>(mapping), mappingSize)) {
+        constants.clear();
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+// validates the header and the sections it points at, and builds the
+// constant table. anything off and the entry isn't used
+bool ProgramCache::check(const char* base, size_t size) {
+    Header h;
+    std::memcpy(&h, base, sizeof(h));
+
+    char version[16];
+    versionField(version);
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.format != FORMAT
+        || std::memcmp(h.version, version, sizeof(version)) != 0
+        || h.opcodes != OP_COUNT_ || h.byteOrder != ENDIAN_MARK
+        || h.key[0] != key[0] || h.key[1] != key[1] || h.sourceSize != source.size())
+        return false;
+
+    // a damaged or half written file
+    if (h.checksum != hashBytes(base + sizeof(h), size - sizeof(h), key[0]))
+        return false;
+
+    auto fits = [&](uint64_t offset, uint64_t bytes, size_t align) {
+        return offset % align == 0 && offset >= sizeof(Header) && offset + bytes <= size;
+    };
+    if (!fits(h.codeOffset, h.codeSize, 8)
+        || !fits(h.linesOffset, uint64_t(h.lineCount) * sizeof(LineStart), 8)
+        || !fits(h.constantsOffset, uint64_t(h.constantCount) * sizeof(Constant), 8)
+        || h.maxStack < 0 || h.maxLocals < 0
+        || !validCode(reinterpret_cast<const uint8_t*>(base + h.codeOffset), h.codeSize,
+                      h.constantCount, h.maxLocals))
+        return false;
+
+    constants.reserve(h.constantCount);
+    for (uint32_t i = 0; i < h.constantCount; i++) {
+        Constant c;
+        std::memcpy(&c, base + h.constantsOffset + i * sizeof(Constant), sizeof(c));
+        switch (static_cast<ValueType>(c.type)) {
+            case ValueType::Null: constants.emplace_back(); break;
+            case ValueType::Int:  constants.emplace_back(static_cast<int>(c.payload)); break;
+            case ValueType::Bool: constants.emplace_back(c.payload != 0); break;
+            case ValueType::Char: constants.emplace_back(static_cast<char>(c.payload)); break;
+            case ValueType::String: {
+                uint32_t length;
+                if (c.payload < sizeof(length) || uint64_t(c.payload) + c.length > size)
+                    return false;
+                std::memcpy(&length, base + c.payload - sizeof(length), sizeof(length));
+                if (length != c.length) return false;
+
+                const char* text = base + c.payload;
+                if (c.symbol == NO_SYMBOL)
+                    constants.push_back(Value::string(std::string_view(text, length)));
+                else
+                    constants.push_back(Value::interned(c.symbol, text));
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    view.code = reinterpret_cast<const uint8_t*>(base + h.codeOffset);
+    view.codeSize = h.codeSize;
+    view.constants = constants.data();
+    view.constantCount = constants.size();
+    view.lines = reinterpret_cast<const LineStart*>(base + h.linesOffset);
+    view.lineCount = h.lineCount;
+    view.maxStack = h.maxStack;
+    view.maxLocals = h.maxLocals;
+    return true;
+}
+
+void ProgramCache::store(const Chunk& chunk) {
+#ifndef _WIN32
+    if (entry.empty()) return;
+
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.format = FORMAT;
+    versionField(h.version);
+    h.opcodes = OP_COUNT_;
+    h.byteOrder = ENDIAN_MARK;
+    h.key[0] = key[0];
+    h.key[1] = key[1];
+    h.sourceSize = source.size();
+    h.maxStack = chunk.maxStack;
+    h.maxLocals = chunk.maxLocals;
+
+    std::string out(sizeof(Header), '\0');
+    h.codeOffset = static_cast<uint32_t>(out.size());
+    h.codeSize = static_cast<uint32_t>(chunk.code.size());
+    out.append(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size());
+    out.resize(padTo(out.size(), 8));
+
+    h.linesOffset = static_cast<uint32_t>(out.size());
+    h.lineCount = static_cast<uint32_t>(chunk.lines.size());
+    for (const LineStart& l : chunk.lines) append(out, l);
+
+    // strings go after the table, so lay them out first to know where
+    h.constantsOffset = static_cast<uint32_t>(out.size());
+    h.constantCount = static_cast<uint32_t>(chunk.constants.size());
+    size_t stringsAt = out.size() + chunk.constants.size() * sizeof(Constant);
+    std::string strings;
+
+    for (const Value& v : chunk.constants) {
+        Constant c{};
+        c.type = static_cast<uint8_t>(v.type());
+        switch (v.type()) {
+            case ValueType::Null:   break;
+            case ValueType::Int:    c.payload = static_cast<uint32_t>(v.asInt()); break;
+            case ValueType::Bool:   c.payload = v.asBool(); break;
+            case ValueType::Char:   c.payload = static_cast<unsigned char>(v.asChar()); break;
+            case ValueType::String: {
+                std::string_view text = v.asString();
+                c.symbol = v.symbol();
+                c.length = static_cast<uint32_t>(text.size());
+                append(strings, c.length);
+                c.payload = static_cast<uint32_t>(stringsAt + strings.size());
+                strings.append(text);
+                strings.resize(padTo(strings.size(), 4));
+                break;
+            }
+        }
+        append(out, c);
+    }
+    out += strings;
+
+    h.checksum = hashBytes(out.data() + sizeof(h), out.size() - sizeof(h), key[0]);
+    std::memcpy(out.data(), &h, sizeof(h));
+
+    // written to the side and renamed into place, so a reader sees the old
+    // entry or the new one and never half of one. a run that still has the
+    // old one mapped keeps its copy. the temp name is unique per call, --jobs
+    // can have two copies of one script storing at once
+    if (!makeDirs(dir)) return;
+    std::string temp = entry + ".XXXXXX";
+    int fd = mkstemp(temp.data());
+    if (fd < 0) return;
+    fchmod(fd, 0644);
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = write(fd, out.data() + written, out.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    bool ok = close(fd) == 0 && written == out.size();
+    if (!ok || rename(temp.c_str(), entry.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    prune();
+#else
+    (void)chunk;
+#endif
+}
+
+// keeps the directory under MAX_CACHE_BYTES by deleting the entries used
+// longest ago, by mtime, which load() bumps. another run may be pruning
+// too, or have one of them mapped, and neither matters
+void ProgramCache::prune() {
+#ifndef _WIN32
+    DIR* listing = opendir(dir.c_str());
+    if (!listing) return;
+
+    struct Entry {
+        time_t used;
+        uint64_t size;
+        std::string path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    time_t now = std::time(nullptr);
+    while (dirent* e = readdir(listing)) {
+        std::string_view name = e->d_name;
+        bool finished = name.size() > 5 && name.substr(name.size() - 5) == ".zenc";
+        bool temp = name.find(".zenc.") != std::string_view::npos;
+        if (!finished && !temp) continue;
+
+        std::string path = dir + "/" + std::string(name);
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+        if (temp) {
+            if (now - info.st_mtime > ABANDONED_SECONDS) unlink(path.c_str());
+            continue;
+        }
+        entries.push_back({info.st_mtime, static_cast<uint64_t>(info.st_size), std::move(path)});
+        total += static_cast<uint64_t>(info.st_size);
+    }
+    closedir(listing);
+    if (total <= MAX_CACHE_BYTES) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& e : entries) {
+        if (total <= MAX_CACHE_BYTES) break;
+        if (e.path == entry) continue;
+        if (unlink(e.path.c_str()) == 0) total -= e.size;
+    }
+#endif
+}
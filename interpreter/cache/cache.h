@@ -0,0 +1,72 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "interpreter/compiler/chunk.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the hash entries are named and checked with, the server keys its
+// programs with it too. good enough to tell scripts apart and catch a
+// damaged file, not meant to stand up to anyone trying to collide it
+uint64_t hashBytes(const char* p, size_t n, uint64_t seed);
+
+// compiled programs kept on disk, so running a script that hasn't changed
+// skips lexing, parsing, resolving, folding and compiling.
+//
+// entries are named after a hash of the source text, so a script is found
+// again wherever it lives and an edited one simply gets a new entry. each
+// .zenc file is laid out the way the vm wants it: the bytecode and the line
+// table are used straight out of the mapping and string constants point
+// into it, so loading is an mmap plus a checksum, nothing gets decoded.
+//
+// the hash covers the interpreter version and bytecode format too, so
+// versions sharing a directory never see each other's entries. one that's
+// been truncated or scribbled on fails the header, checksum or operand
+// checks, and is treated as a miss and written over. the directory is
+// otherwise trusted: operand types and stack depths are taken as written.
+//
+// store() keeps the directory under a size cap, deleting the entries used
+// longest ago first.
+class ProgramCache {
+    public:
+        // entries go in dir, see defaultDir()
+        ProgramCache(std::string dir, std::string_view source);
+        ~ProgramCache();
+
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+
+        // $ZENITH_CACHE_DIR, else $XDG_CACHE_HOME/zenith, else ~/.cache/zenith.
+        // empty if none of those are set
+        static std::string defaultDir();
+
+        // maps the entry for this source, false if there's no usable one
+        bool load();
+        // only valid after load() returned true, and while the cache is alive
+        const ChunkView& program() const { return view; }
+
+        // best effort, a cache that can't be written is just a slow cache
+        void store(const Chunk& chunk);
+
+        const std::string& path() const { return entry; }
+
+    private:
+        std::string dir;
+        std::string entry;
+        std::string_view source;
+        uint64_t key[2] = {};
+
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+        // string constants point into the mapping, these are the only
+        // things built at load time
+        std::vector<Value> constants;
+        ChunkView view;
+
+        bool check(const char* base, size_t size);
+        void prune();
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "checker.h"
+#include "interpreter/error.h"
+#include <string>
+
+namespace {
+
+bool known(StaticType type) {
+    return type != StaticType::Dynamic;
+}
+
+} // namespace
+
+void Checker::check(Ast& program, int globals) {
+    ast = &program;
+
+    // every top level slot starts out as a host variable, declarations
+    // take theirs over
+    std::vector<std::vector<uint32_t>> scopes(1);
+    for (int i = 0; i < globals; i++) {
+        scopes.back().push_back(static_cast<uint32_t>(variables.size()));
+        variables.push_back({StaticType::Dynamic});
+    }
+    for (NodeId stmt : program.statements) bind(stmt, scopes);
+
+    // a variable assigned something else goes Dynamic, and then so does
+    // everything reading it, which can widen more variables. types only
+    // ever widen, so this settles, and the last pass saw them all settled
+    do {
+        widened = false;
+        errors.clear();
+        for (NodeId stmt : program.statements) checkStatement(stmt);
+    } while (widened);
+
+    // report everything we found, then bail before running anything
+    if (!errors.empty()) throw ScriptError(errors);
+}
+
+// works out which variable each name means and numbers it in the node. the
+// resolver's depth and slot are relative to the scopes open at that point
+void Checker::bind(NodeId id, std::vector<std::vector<uint32_t>>& scopes) {
+    auto lookup = [&](int depth, int slot) {
+        if (depth < 0 || depth >= static_cast<int>(scopes.size())) return UINT32_MAX;
+        const auto& scope = scopes[scopes.size() - 1 - depth];
+        return slot >= 0 && slot < static_cast<int>(scope.size()) ? scope[slot] : UINT32_MAX;
+    };
+
+    switch (kindOf(id)) {
+        case NodeKind::Print:
+            bind(ast->get<PrintStatement>(id).expr, scopes);
+            return;
+        case NodeKind::VarDecl: {
+            auto& s = ast->get<VarDeclStatement>(id);
+            bind(s.initialiser, scopes);
+            s.variable = static_cast<uint32_t>(variables.size());
+            variables.push_back({declaredType(s.typeKeyword)});
+            if (s.slot >= 0 && s.slot < static_cast<int>(scopes.back().size())) scopes.back()[s.slot] = s.variable;
+            return;
+        }
+        case NodeKind::Block: {
+            const auto& s = ast->get<BlockStatement>(id);
+            scopes.emplace_back(s.slotCount, UINT32_MAX);
+            for (const NodeId* it = ast->begin(s); it != ast->end(s); ++it) bind(*it, scopes);
+            scopes.pop_back();
+            return;
+        }
+        case NodeKind::If: {
+            const auto& s = ast->get<IfStatement>(id);
+            bind(s.condition, scopes);
+            bind(s.thenBranch, scopes);
+            if (s.elseBranch != NO_NODE) bind(s.elseBranch, scopes);
+            return;
+        }
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            bind(s.condition, scopes);
+            bind(s.body, scopes);
+            return;
+        }
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            bind(s.init, scopes);
+            bind(s.condition, scopes);
+            bind(s.increment, scopes);
+            bind(s.body, scopes);
+            return;
+        }
+        case NodeKind::ExpressionStmt:
+            bind(ast->get<ExpressionStatement>(id).expr, scopes);
+            return;
+
+        case NodeKind::Identifier: {
+            auto& e = ast->get<IdentifierExpression>(id);
+            e.variable = lookup(e.depth, e.slot);
+            if (e.variable == UINT32_MAX) break;
+            return;
+        }
+        case NodeKind::Assignment: {
+            bind(ast->get<AssignmentExpression>(id).value, scopes);
+            auto& e = ast->get<AssignmentExpression>(id);
+            e.variable = lookup(e.depth, e.slot);
+            if (e.variable == UINT32_MAX) break;
+            return;
+        }
+        case NodeKind::Unary:
+            bind(ast->get<UnaryExpression>(id).expr, scopes);
+            return;
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            bind(e.left, scopes);
+            bind(e.right, scopes);
+            return;
+        }
+        case NodeKind::Literal:
+            return;
+    }
+
+    // the resolver should have caught it
+    throw ScriptError("[ERROR] Unresolved variable.\n");
+}
+
+// statements
+
+void Checker::checkStatement(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Print:
+            checkExpression(ast->get<PrintStatement>(id).expr);
+            return;
+
+        case NodeKind::VarDecl: {
+            StaticType init = checkExpression(ast->get<VarDeclStatement>(id).initialiser);
+            auto& s = ast->get<VarDeclStatement>(id);
+            // a Dynamic initialiser is still checked when it runs
+            if (known(init) && init != declaredType(s.typeKeyword))
+                error(s.name.line, "Type mismatch in variable declaration.");
+            s.type = variables[s.variable].type;
+            return;
+        }
+
+        case NodeKind::Block: {
+            const auto& s = ast->get<BlockStatement>(id);
+            for (const NodeId* it = ast->begin(s); it != ast->end(s); ++it) {
+                checkStatement(*it);
+            }
+            return;
+        }
+
+        case NodeKind::If: {
+            const auto& s = ast->get<IfStatement>(id);
+            checkExpression(s.condition);
+            checkStatement(s.thenBranch);
+            if (s.elseBranch != NO_NODE) checkStatement(s.elseBranch);
+            return;
+        }
+
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            checkExpression(s.condition);
+            checkStatement(s.body);
+            return;
+        }
+
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            checkExpression(s.init);
+            checkExpression(s.condition);
+            checkExpression(s.increment);
+            checkStatement(s.body);
+            return;
+        }
+
+        case NodeKind::ExpressionStmt:
+            checkExpression(ast->get<ExpressionStatement>(id).expr);
+            return;
+
+        default:
+            return;
+    }
+}
+
+// expressions
+
+StaticType Checker::checkExpression(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Identifier: {
+            auto& e = ast->get<IdentifierExpression>(id);
+            return e.type = variables[e.variable].type;
+        }
+
+        case NodeKind::Assignment: {
+            StaticType value = checkExpression(ast->get<AssignmentExpression>(id).value);
+            Variable& v = variables[ast->get<AssignmentExpression>(id).variable];
+            if (known(v.type) && value != v.type) {
+                v.type = StaticType::Dynamic;
+                widened = true;
+            }
+            return ast->get<AssignmentExpression>(id).type = v.type;
+        }
+
+        case NodeKind::Unary: {
+            StaticType operand = checkExpression(ast->get<UnaryExpression>(id).expr);
+            auto& e = ast->get<UnaryExpression>(id);
+            if (e.op.type == BANG) return e.type = StaticType::Bool;
+            if (known(operand) && operand != StaticType::Int)
+                error(e.op.line, "Operand of '-' must be an int.");
+            // anything else fails
+            return e.type = StaticType::Int;
+        }
+
+        case NodeKind::Binary: {
+            auto& e = ast->get<BinaryExpression>(id);
+            return e.type = checkBinary(e);
+        }
+
+        default:
+            return ast->typeOf(id);
+    }
+}
+
+StaticType Checker::checkBinary(BinaryExpression& e) {
+    StaticType left = checkExpression(e.left);
+    StaticType right = checkExpression(e.right);
+
+    switch (e.op.type) {
+        // whichever operand decided it
+        case AND:
+        case OR:
+            return left == right ? left : StaticType::Dynamic;
+
+        case EQUAL_EQUAL:
+        case BANG_EQUAL:
+            return StaticType::Bool;
+
+        case PLUS: {
+            auto addable = [](StaticType t) {
+                return !known(t) || t == StaticType::Int || t == StaticType::String;
+            };
+            if (!addable(left) || !addable(right) || (known(left) && known(right) && left != right)) {
+                error(e.op.line, "Operands of '+' must both be int or both be string.");
+                return StaticType::Dynamic;
+            }
+            return left == right ? left : StaticType::Dynamic;
+        }
+
+        default: {
+            // the rest only take ints, and anything else fails
+            if ((known(left) && left != StaticType::Int) || (known(right) && right != StaticType::Int)) {
+                std::string message = "Operands of '" + std::string(e.op.lexeme) + "' must be int.";
+                error(e.op.line, message.c_str());
+            }
+            bool arithmetic = e.op.type == MINUS || e.op.type == STAR || e.op.type == SLASH;
+            return arithmetic ? StaticType::Int : StaticType::Bool;
+        }
+    }
+}
+
+void Checker::error(int line, const char* message) {
+    errors += "[line " + std::to_string(line) + "] TYPE ERROR: " + message + "\n";
+}
@@ -0,0 +1,47 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include "interpreter/parser/ast.h"
+#include <string>
+#include <vector>
+
+// runs between the resolver and the folder. works out every expression's
+// static type from the declarations and literals and writes it into the
+// node, then reports every type error it can prove, together, before
+// anything executes. the compiler picks ops that skip the type checks for
+// whatever this proved.
+//
+// a variable has its declared type unless it's ever assigned something
+// else, then it's Dynamic and so is everything that reads it. those are
+// still checked at runtime, like anything mixing types. only what fails
+// whatever happens at runtime is an error here: "a" - 1, or a string
+// declared int, even in a branch that never runs.
+class Checker {
+    public:
+        // globals is the resolver's top level slot count. the slots no
+        // declaration takes are the host's (zenith.h), they could hold anything
+        void check(Ast& ast, int globals);
+
+    private:
+        struct Variable {
+            StaticType type;
+        };
+
+        Ast* ast = nullptr;
+        // by the number written into each identifier, assignment and declaration
+        std::vector<Variable> variables;
+        // a variable went Dynamic this pass, everything reading it needs another
+        bool widened = false;
+        // every error found in the last pass, reported together at the end
+        std::string errors;
+
+        void bind(NodeId node, std::vector<std::vector<uint32_t>>& scopes);
+
+        void checkStatement(NodeId stmt);
+        StaticType checkExpression(NodeId expr);
+        StaticType checkBinary(BinaryExpression& e);
+
+        void error(int line, const char* message);
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "interpreter/value.h"
+#include <cstdint>
+#include <vector>
+
+// one byte per opcode, operands are 4 byte little endian words that follow it.
+// jumps carry the absolute offset of their target.
+enum OpCode : uint8_t {
+    OP_CONSTANT,        // [const]      push constants[const]
+    OP_NIL,             //              push null
+    OP_TRUE,            //              push true
+    OP_FALSE,           //              push false
+    OP_POP,             //              drop top of stack
+
+    OP_DEFINE_LOCAL,    // [slot][type] pop, check against declared type, store in slot
+    OP_STORE_LOCAL,     // [slot]       pop, store in slot, the checker proved the type
+    OP_GET_LOCAL,       // [slot]       push variable
+    OP_SET_LOCAL,       // [slot]       assign top of stack, leaves it there
+
+    OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE,
+    OP_GREATER, OP_GREATER_EQUAL, OP_LESS, OP_LESS_EQUAL,
+    OP_EQUAL, OP_NOT_EQUAL,
+    OP_NEGATE, OP_NOT,
+
+    // the same without the type checks, for operands the checker (checker.h)
+    // proved are ints. OP_CONCAT is + on two strings
+    OP_ADD_INT, OP_SUBTRACT_INT, OP_MULTIPLY_INT, OP_DIVIDE_INT,
+    OP_GREATER_INT, OP_GREATER_EQUAL_INT, OP_LESS_INT, OP_LESS_EQUAL_INT,
+    OP_NEGATE_INT, OP_CONCAT,
+
+    OP_PRINT,           //              pop and display
+
+    OP_JUMP,            // [target]
+    OP_LOOP,            // [target][loop] jump back to the top of loop number loop,
+                        //              counted so the jit can find hot loops (jit.h)
+    OP_JUMP_IF_FALSE,   // [target]     pop, jump if falsy
+    OP_JUMP_IF_FALSE_OR_POP, // [target] jump if falsy and keep it, else pop (and)
+    OP_JUMP_IF_TRUE_OR_POP,  // [target] jump if truthy and keep it, else pop (or)
+
+    // superinstructions, the commonest shapes in one dispatch each. they do
+    // exactly what the ops they replace would, errors included. [cmp] is a
+    // single byte, the comparison op it stands for (OP_LESS, OP_LESS_INT etc)
+    OP_ADD_LOCAL_CONST, // [slot][const] slot = slot + const, for x = x + 1; with an int x
+    OP_COMPARE_JUMP,    // [cmp][target] pop two, jump if the comparison is false
+    OP_LOCAL_CONST_COMPARE_JUMP, // [cmp][slot][const][target] same, a local against a constant
+    OP_LOCALS_COMPARE_JUMP,      // [cmp][a][b][target] same, two locals
+
+    OP_MARK,            // [index]      top level statement index starts here, only for --trace
+
+    OP_HALT,
+
+    OP_COUNT_, // keep last, sizes the dispatch table
+};
+
+// the line table is run length encoded, one entry wherever the line changes.
+// only looked at when reporting errors
+struct LineStart {
+    uint32_t offset;
+    int line;
+};
+
+// what the vm runs: a chunk's arrays wherever they live, in a Chunk or
+// straight out of a mapped .zenc file (see cache.h)
+struct ChunkView {
+    const uint8_t* code = nullptr;
+    size_t codeSize = 0;
+    const Value* constants = nullptr;
+    size_t constantCount = 0;
+    const LineStart* lines = nullptr;
+    size_t lineCount = 0;
+    int maxStack = 0;
+    int maxLocals = 0;
+
+    int lineAt(size_t offset) const {
+        int line = 0;
+        for (size_t i = 0; i < lineCount && lines[i].offset <= offset; i++)
+            line = lines[i].line;
+        return line;
+    }
+};
+
+struct Chunk {
+    std::vector<uint8_t> code;
+    std::vector<Value> constants;
+    std::vector<LineStart> lines;
+
+    // deepest the operand stack gets, worked out by the compiler
+    int maxStack = 0;
+    // locals are flattened into one frame, a slot per variable live at once
+    int maxLocals = 0;
+
+    void write(uint8_t byte, int line) {
+        if (lines.empty() || lines.back().line != line)
+            lines.push_back({static_cast<uint32_t>(code.size()), line});
+        code.push_back(byte);
+    }
+
+    void writeOperand(uint32_t operand, int line) {
+        for (int i = 0; i < 4; i++)
+            write(static_cast<uint8_t>(operand >> (8 * i)), line);
+    }
+
+    void patchOperand(size_t offset, uint32_t operand) {
+        for (int i = 0; i < 4; i++)
+            code[offset + i] = static_cast<uint8_t>(operand >> (8 * i));
+    }
+
+    ChunkView view() const {
+        return {code.data(), code.size(), constants.data(), constants.size(),
+                lines.data(), lines.size(), maxStack, maxLocals};
+    }
+
+    int lineAt(size_t offset) const { return view().lineAt(offset); }
+};
+
+inline uint32_t readOperand(const uint8_t* at) {
+    return static_cast<uint32_t>(at[0])
+         | static_cast<uint32_t>(at[1]) << 8
+         | static_cast<uint32_t>(at[2]) << 16
+         | static_cast<uint32_t>(at[3]) << 24;
+}
+
+// the opcode and its operands, in bytes
+inline size_t instructionSize(uint8_t op) {
+    switch (op) {
+        case OP_CONSTANT: case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_STORE_LOCAL:
+        case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+        case OP_MARK:
+            return 5;
+        case OP_DEFINE_LOCAL: return 6;
+        case OP_COMPARE_JUMP: return 6;
+        case OP_LOOP: case OP_ADD_LOCAL_CONST: return 9;
+        case OP_LOCAL_CONST_COMPARE_JUMP: case OP_LOCALS_COMPARE_JUMP: return 14;
+        default:              return 1;
+    }
+}
+
+#endif
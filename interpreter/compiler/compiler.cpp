@@ -0,0 +1,353 @@
+#include "compiler.h"
+#include "interpreter/error.h"
+#include <string>
+
+namespace {
+
+// how many values each op leaves on the stack, used to size the vm stack.
+// conditional pops count as popping since the fallthrough path does.
+int stackEffect(OpCode op) {
+    switch (op) {
+        case OP_CONSTANT:
+        case OP_NIL:
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_GET_LOCAL:
+            return 1;
+
+        case OP_POP:
+        case OP_DEFINE_LOCAL:
+        case OP_STORE_LOCAL:
+        case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+        case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL:
+        case OP_EQUAL: case OP_NOT_EQUAL:
+        case OP_ADD_INT: case OP_SUBTRACT_INT: case OP_MULTIPLY_INT: case OP_DIVIDE_INT:
+        case OP_GREATER_INT: case OP_GREATER_EQUAL_INT: case OP_LESS_INT: case OP_LESS_EQUAL_INT:
+        case OP_CONCAT:
+        case OP_PRINT:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_FALSE_OR_POP:
+        case OP_JUMP_IF_TRUE_OR_POP:
+            return -1;
+
+        case OP_COMPARE_JUMP:
+            return -2;
+
+        default:
+            return 0;
+    }
+}
+
+OpCode binaryOp(TokenType type) {
+    switch (type) {
+        case PLUS:          return OP_ADD;
+        case MINUS:         return OP_SUBTRACT;
+        case STAR:          return OP_MULTIPLY;
+        case SLASH:         return OP_DIVIDE;
+        case GREATER:       return OP_GREATER;
+        case GREATER_EQUAL: return OP_GREATER_EQUAL;
+        case LESS:          return OP_LESS;
+        case LESS_EQUAL:    return OP_LESS_EQUAL;
+        case EQUAL_EQUAL:   return OP_EQUAL;
+        case BANG_EQUAL:    return OP_NOT_EQUAL;
+        default:            return OP_COUNT_;
+    }
+}
+
+// op without its type checks, when the checker proved the operands fit
+OpCode specialise(OpCode op, StaticType left, StaticType right) {
+    if (op == OP_ADD && left == StaticType::String && right == StaticType::String) return OP_CONCAT;
+    if (left != StaticType::Int || right != StaticType::Int) return op;
+    switch (op) {
+        case OP_ADD:           return OP_ADD_INT;
+        case OP_SUBTRACT:      return OP_SUBTRACT_INT;
+        case OP_MULTIPLY:      return OP_MULTIPLY_INT;
+        case OP_DIVIDE:        return OP_DIVIDE_INT;
+        case OP_GREATER:       return OP_GREATER_INT;
+        case OP_GREATER_EQUAL: return OP_GREATER_EQUAL_INT;
+        case OP_LESS:          return OP_LESS_INT;
+        case OP_LESS_EQUAL:    return OP_LESS_EQUAL_INT;
+        default:               return op;
+    }
+}
+
+bool isComparison(OpCode op) {
+    return (op >= OP_GREATER && op <= OP_NOT_EQUAL) || (op >= OP_GREATER_INT && op <= OP_LESS_EQUAL_INT);
+}
+
+} // namespace
+
+Chunk Compiler::compile(const Ast& program, int globals) {
+    ast = &program;
+    scopeBase.push_back(0);
+    localTop = globals;
+    chunk.maxLocals = globals;
+
+    for (size_t i = 0; i < program.statements.size(); i++) {
+        if (markStatements) emit(OP_MARK, static_cast<uint32_t>(i), program.lineOf(program.statements[i]));
+        compileStatement(program.statements[i]);
+    }
+    emit(OP_HALT, 0);
+    return std::move(chunk);
+}
+
+// statements
+
+void Compiler::compileStatement(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Print:
+            compileExpression(ast->get<PrintStatement>(id).expr);
+            emit(OP_PRINT, 0);
+            return;
+
+        case NodeKind::VarDecl: {
+            const auto& s = ast->get<VarDeclStatement>(id);
+            compileExpression(s.initialiser);
+            if (ast->typeOf(s.initialiser) == declaredType(s.typeKeyword)) {
+                emit(OP_STORE_LOCAL, localSlot(0, s.slot), s.name.line);
+                return;
+            }
+            emit(OP_DEFINE_LOCAL, localSlot(0, s.slot), s.name.line);
+            chunk.write(static_cast<uint8_t>(s.typeKeyword), s.name.line);
+            return;
+        }
+
+        case NodeKind::Block: {
+            const auto& s = ast->get<BlockStatement>(id);
+            // no runtime work to enter a block, its variables just get the next slots
+            scopeBase.push_back(localTop);
+            localTop += s.slotCount;
+            if (localTop > chunk.maxLocals) chunk.maxLocals = localTop;
+
+            for (const NodeId* it = ast->begin(s); it != ast->end(s); ++it) {
+                compileStatement(*it);
+            }
+
+            localTop = scopeBase.back();
+            scopeBase.pop_back();
+            return;
+        }
+
+        case NodeKind::If: {
+            const auto& s = ast->get<IfStatement>(id);
+            size_t elseJump = compileCondition(s.condition);
+            compileStatement(s.thenBranch);
+            if (s.elseBranch != NO_NODE) {
+                size_t endJump = emitJump(OP_JUMP, 0);
+                patchJump(elseJump);
+                compileStatement(s.elseBranch);
+                patchJump(endJump);
+            } else {
+                patchJump(elseJump);
+            }
+            return;
+        }
+
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            size_t loopStart = chunk.code.size();
+            size_t exitJump = compileCondition(s.condition);
+            compileStatement(s.body);
+            emitLoop(loopStart, 0);
+            patchJump(exitJump);
+            return;
+        }
+
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            // init runs once
+            compileDiscarded(s.init);
+            size_t loopStart = chunk.code.size();
+            size_t exitJump = compileCondition(s.condition);
+            compileStatement(s.body);
+            compileDiscarded(s.increment);
+            emitLoop(loopStart, 0);
+            patchJump(exitJump);
+            return;
+        }
+
+        case NodeKind::ExpressionStmt:
+            compileDiscarded(ast->get<ExpressionStatement>(id).expr);
+            return;
+
+        default:
+            break;
+    }
+
+    throw ScriptError("[ERROR] Unknown statement type.\n");
+}
+
+// expressions
+
+void Compiler::compileExpression(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Literal: {
+            const auto& e = ast->get<LiteralExpression>(id);
+            const Value& value = ast->constants[e.constant];
+            int line = e.op.line;
+            if (value.isBool())
+                emit(value.asBool() ? OP_TRUE : OP_FALSE, line);
+            else if (value.isNull())
+                emit(OP_NIL, line);
+            else
+                emit(OP_CONSTANT, makeConstant(value), line);
+            return;
+        }
+
+        case NodeKind::Identifier: {
+            const auto& e = ast->get<IdentifierExpression>(id);
+            emit(OP_GET_LOCAL, localSlot(e.depth, e.slot), e.name.line);
+            return;
+        }
+
+        case NodeKind::Assignment: {
+            const auto& e = ast->get<AssignmentExpression>(id);
+            compileExpression(e.value);
+            emit(OP_SET_LOCAL, localSlot(e.depth, e.slot), e.name.line);
+            return;
+        }
+
+        case NodeKind::Unary: {
+            const auto& e = ast->get<UnaryExpression>(id);
+            compileExpression(e.expr);
+            switch (e.op.type) {
+                case MINUS:
+                    emit(ast->typeOf(e.expr) == StaticType::Int ? OP_NEGATE_INT : OP_NEGATE, e.op.line);
+                    return;
+                case BANG:  emit(OP_NOT, e.op.line);    return;
+                default: break;
+            }
+            break;
+        }
+
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            // short circuit, the right side is skipped when the left decides it
+            if (e.op.type == AND || e.op.type == OR) {
+                compileExpression(e.left);
+                size_t endJump = emitJump(e.op.type == AND ? OP_JUMP_IF_FALSE_OR_POP
+                                                           : OP_JUMP_IF_TRUE_OR_POP, e.op.line);
+                compileExpression(e.right);
+                patchJump(endJump);
+                return;
+            }
+
+            OpCode op = binaryOp(e.op.type);
+            if (op != OP_COUNT_) {
+                compileExpression(e.left);
+                compileExpression(e.right);
+                emit(specialise(op, ast->typeOf(e.left), ast->typeOf(e.right)), e.op.line);
+                return;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    throw ScriptError("[ERROR] Unknown expression type.\n");
+}
+
+// superinstructions. these only pick the ops, what they do is in the vm
+
+void Compiler::compileDiscarded(NodeId id) {
+    // x = x + c with an int x and an int constant, counters mostly
+    if (kindOf(id) == NodeKind::Assignment) {
+        const auto& e = ast->get<AssignmentExpression>(id);
+        if (kindOf(e.value) == NodeKind::Binary) {
+            const auto& sum = ast->get<BinaryExpression>(e.value);
+            uint32_t slot = localSlot(e.depth, e.slot);
+            if (sum.op.type == PLUS && kindOf(sum.left) == NodeKind::Identifier
+                && kindOf(sum.right) == NodeKind::Literal) {
+                const auto& x = ast->get<IdentifierExpression>(sum.left);
+                const Value& c = ast->constants[ast->get<LiteralExpression>(sum.right).constant];
+                if (c.isInt() && x.type == StaticType::Int && localSlot(x.depth, x.slot) == slot) {
+                    emit(OP_ADD_LOCAL_CONST, slot, sum.op.line);
+                    chunk.writeOperand(makeConstant(c), sum.op.line);
+                    return;
+                }
+            }
+        }
+    }
+    compileExpression(id);
+    emit(OP_POP, 0);
+}
+
+size_t Compiler::compileCondition(NodeId id) {
+    if (kindOf(id) == NodeKind::Binary) {
+        const auto& e = ast->get<BinaryExpression>(id);
+        OpCode cmp = specialise(binaryOp(e.op.type), ast->typeOf(e.left), ast->typeOf(e.right));
+        if (isComparison(cmp)) {
+            int line = e.op.line;
+            if (kindOf(e.left) == NodeKind::Identifier) {
+                const auto& a = ast->get<IdentifierExpression>(e.left);
+                if (kindOf(e.right) == NodeKind::Identifier) {
+                    const auto& b = ast->get<IdentifierExpression>(e.right);
+                    emit(OP_LOCALS_COMPARE_JUMP, line);
+                    chunk.write(cmp, line);
+                    chunk.writeOperand(localSlot(a.depth, a.slot), line);
+                    chunk.writeOperand(localSlot(b.depth, b.slot), line);
+                    chunk.writeOperand(0, line);
+                    return chunk.code.size() - 4;
+                }
+                if (kindOf(e.right) == NodeKind::Literal) {
+                    const Value& c = ast->constants[ast->get<LiteralExpression>(e.right).constant];
+                    if (c.isInt()) {
+                        emit(OP_LOCAL_CONST_COMPARE_JUMP, line);
+                        chunk.write(cmp, line);
+                        chunk.writeOperand(localSlot(a.depth, a.slot), line);
+                        chunk.writeOperand(makeConstant(c), line);
+                        chunk.writeOperand(0, line);
+                        return chunk.code.size() - 4;
+                    }
+                }
+            }
+            compileExpression(e.left);
+            compileExpression(e.right);
+            emit(OP_COMPARE_JUMP, line);
+            chunk.write(cmp, line);
+            chunk.writeOperand(0, line);
+            return chunk.code.size() - 4;
+        }
+    }
+    compileExpression(id);
+    return emitJump(OP_JUMP_IF_FALSE, 0);
+}
+
+// emitting
+
+void Compiler::emit(OpCode op, int line) {
+    chunk.write(op, line);
+    stackDepth += stackEffect(op);
+    if (stackDepth > chunk.maxStack) chunk.maxStack = stackDepth;
+}
+
+void Compiler::emit(OpCode op, uint32_t operand, int line) {
+    emit(op, line);
+    chunk.writeOperand(operand, line);
+}
+
+// emits a forward jump with a placeholder target, returns where the target goes
+size_t Compiler::emitJump(OpCode op, int line) {
+    emit(op, 0, line);
+    return chunk.code.size() - 4;
+}
+
+void Compiler::patchJump(size_t operandOffset) {
+    chunk.patchOperand(operandOffset, static_cast<uint32_t>(chunk.code.size()));
+}
+
+void Compiler::emitLoop(size_t target, int line) {
+    emit(OP_LOOP, static_cast<uint32_t>(target), line);
+    chunk.writeOperand(loopCount++, line);
+}
+
+uint32_t Compiler::makeConstant(Value value) {
+    chunk.constants.push_back(std::move(value));
+    return static_cast<uint32_t>(chunk.constants.size() - 1);
+}
+
+uint32_t Compiler::localSlot(int depth, int slot) const {
+    return static_cast<uint32_t>(scopeBase[scopeBase.size() - 1 - depth] + slot);
+}
@@ -0,0 +1,48 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "interpreter/compiler/chunk.h"
+#include "interpreter/parser/ast.h"
+#include <vector>
+
+// lowers the ast into a flat chunk for the vm, so nothing dispatches on node
+// kinds at runtime.
+class Compiler {
+    public:
+        // expects resolved statements, globals is the resolver's top level slot count
+        Chunk compile(const Ast& ast, int globals);
+
+        // put an OP_MARK in front of every top level statement, for --trace
+        void setMarkStatements(bool on) { markStatements = on; }
+
+    private:
+        const Ast* ast = nullptr;
+        Chunk chunk;
+        int stackDepth = 0;
+        bool markStatements = false;
+        uint32_t loopCount = 0;
+
+        // frame slot where each open scope's variables start, innermost at the back
+        std::vector<int> scopeBase;
+        int localTop = 0;
+
+        void compileStatement(NodeId stmt);
+        void compileExpression(NodeId expr);
+        // an expression whose value nobody wants
+        void compileDiscarded(NodeId expr);
+        // jumps when cond is falsy, returns the jump's operand to patch
+        size_t compileCondition(NodeId cond);
+
+        // emitting
+        void emit(OpCode op, int line);
+        void emit(OpCode op, uint32_t operand, int line);
+        size_t emitJump(OpCode op, int line);
+        void patchJump(size_t operandOffset);
+        // the back edge of a loop starting at target
+        void emitLoop(size_t target, int line);
+
+        uint32_t makeConstant(Value value);
+        uint32_t localSlot(int depth, int slot) const;
+};
+
+#endif
@@ -0,0 +1,444 @@
+#include "cppgen.h"
+#include "interpreter/error.h"
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace {
+
+// zenith names can be c++ keywords (class, new), the suffix keeps them
+// apart, and keeps shadowed variables apart too
+std::string mangle(std::string_view name, size_t index) {
+    std::string s;
+    for (char c : name) s += std::isalnum(static_cast<unsigned char>(c)) || c == '_' ? c : '_';
+    return s + "_" + std::to_string(index);
+}
+
+std::string quote(std::string_view text) {
+    std::string s = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            s += '\\';
+            s += static_cast<char>(c);
+        } else if (c >= 0x20 && c < 0x7f) {
+            s += static_cast<char>(c);
+        } else {
+            char escape[5];
+            std::snprintf(escape, sizeof(escape), "\\%03o", c);
+            s += escape;
+        }
+    }
+    return s + "\"";
+}
+
+bool isLiteral(NodeId expr) {
+    return kindOf(expr) == NodeKind::Literal;
+}
+
+bool isComparison(TokenType op) {
+    return op == GREATER || op == GREATER_EQUAL || op == LESS || op == LESS_EQUAL;
+}
+
+} // namespace
+
+std::string CppGen::generate(const Ast& program, const std::string& source) {
+    ast = &program;
+    stringConstant.assign(program.constants.size(), -1);
+
+    for (NodeId stmt : program.statements) statement(stmt, 1);
+
+    std::string out;
+    out += "// generated by zenith --emit-cpp from " + source + "\n";
+    out += "// build it next to " + std::string(CPP_RUNTIME_NAME) + " with a c++17 compiler:\n";
+    out += "//   c++ -std=c++17 -O2 program.cpp -o program\n";
+    out += "#include \"" + std::string(CPP_RUNTIME_NAME) + "\"\n\n";
+    if (!constants.empty()) out += constants + "\n";
+    out += "static void program() {\n" + body + "}\n\n";
+    out += "int main() {\n    return zen::main(program);\n}\n";
+    return out;
+}
+
+// statements
+
+void CppGen::line(int indent, const std::string& text) {
+    body.append(static_cast<size_t>(indent) * 4, ' ');
+    body += text;
+    body += '\n';
+}
+
+void CppGen::statement(NodeId id, int indent) {
+    switch (kindOf(id)) {
+        case NodeKind::Print:
+            line(indent, "zen::display(" + expression(ast->get<PrintStatement>(id).expr) + ");");
+            return;
+
+        case NodeKind::VarDecl: {
+            const auto& s = ast->get<VarDeclStatement>(id);
+            std::string name = mangle(s.name.lexeme, s.variable);
+            Type type = fromStatic(s.type);
+            Type declared = fromStatic(declaredType(s.typeKeyword));
+            Type init = typeOf(s.initialiser);
+            std::string at = std::to_string(s.name.line);
+            if (type != Type::Dynamic && init == type) {
+                line(indent, std::string(cppType(type)) + " " + name + " = " + expression(s.initialiser) + ";");
+            } else if (type != Type::Dynamic) {
+                line(indent, std::string(cppType(type)) + " " + name + " = zen::declared<" + cppType(type) + ">("
+                             + as(Type::Dynamic, s.initialiser) + ", " + at + ");");
+            } else if (init == declared) {
+                line(indent, "zen::Value " + name + " = " + as(Type::Dynamic, s.initialiser) + ";");
+            } else {
+                line(indent, "zen::Value " + name + " = zen::checked<" + cppType(declared) + ">("
+                             + as(Type::Dynamic, s.initialiser) + ", " + at + ");");
+            }
+            return;
+        }
+
+        case NodeKind::Block:
+            line(indent, "{");
+            block(id, indent + 1);
+            line(indent, "}");
+            return;
+
+        case NodeKind::If:
+            ifChain(id, indent, "");
+            return;
+
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            line(indent, "while (" + as(Type::Bool, s.condition) + ") {");
+            block(s.body, indent + 1);
+            line(indent, "}");
+            return;
+        }
+
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            line(indent, "(void)" + expression(s.init) + ";");
+            line(indent, "while (" + as(Type::Bool, s.condition) + ") {");
+            // the body's own scope, the increment is outside it
+            statement(s.body, indent + 1);
+            line(indent + 1, "(void)" + expression(s.increment) + ";");
+            line(indent, "}");
+            return;
+        }
+
+        case NodeKind::ExpressionStmt:
+            line(indent, "(void)" + expression(ast->get<ExpressionStatement>(id).expr) + ";");
+            return;
+
+        default:
+            break;
+    }
+    throw ScriptError("[ERROR] Unknown statement type.\n");
+}
+
+// the statements of a block, without opening a c++ scope for it
+void CppGen::block(NodeId id, int indent) {
+    if (kindOf(id) != NodeKind::Block) {
+        statement(id, indent);
+        return;
+    }
+    const auto& s = ast->get<BlockStatement>(id);
+    for (const NodeId* it = ast->begin(s); it != ast->end(s); ++it) statement(*it, indent);
+}
+
+void CppGen::ifChain(NodeId id, int indent, const std::string& prefix) {
+    const auto& s = ast->get<IfStatement>(id);
+    line(indent, prefix + "if (" + as(Type::Bool, s.condition) + ") {");
+    block(s.thenBranch, indent + 1);
+    if (s.elseBranch == NO_NODE) {
+        line(indent, "}");
+    } else if (kindOf(s.elseBranch) == NodeKind::If) {
+        ifChain(s.elseBranch, indent, "} else ");
+    } else {
+        line(indent, "} else {");
+        block(s.elseBranch, indent + 1);
+        line(indent, "}");
+    }
+}
+
+// expressions
+
+// the checker's, null is just another Dynamic here
+CppGen::Type CppGen::typeOf(NodeId id) const {
+    return fromStatic(ast->typeOf(id));
+}
+
+// expr, converted to type. only two conversions ever happen: anything to
+// Dynamic, and anything to a Bool condition
+std::string CppGen::as(Type type, NodeId id) {
+    Type from = typeOf(id);
+    if (from == type) return expression(id);
+    if (type == Type::Bool) return "zen::truthy(" + expression(id) + ")";
+    return "zen::Value(" + expression(id) + ")";
+}
+
+std::string CppGen::expression(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Literal:
+            return literal(ast->get<LiteralExpression>(id));
+        case NodeKind::Identifier: {
+            const auto& e = ast->get<IdentifierExpression>(id);
+            return mangle(e.name.lexeme, e.variable);
+        }
+        case NodeKind::Assignment:
+            return assignment(id);
+        case NodeKind::Unary: {
+            const auto& e = ast->get<UnaryExpression>(id);
+            if (e.op.type == MINUS) {
+                if (typeOf(e.expr) == Type::Int) return "zen::neg(" + expression(e.expr) + ")";
+                return "zen::negate(" + as(Type::Dynamic, e.expr) + ", " + std::to_string(e.op.line) + ")";
+            }
+            return "(!" + as(Type::Bool, e.expr) + ")";
+        }
+        case NodeKind::Binary:
+            return binary(ast->get<BinaryExpression>(id));
+        default:
+            break;
+    }
+    throw ScriptError("[ERROR] Unknown expression type.\n");
+}
+
+std::string CppGen::literal(const LiteralExpression& e) {
+    const Value& v = ast->constants[e.constant];
+    if (v.isInt()) {
+        if (v.asInt() == INT_MIN) return "(-2147483647 - 1)";
+        return v.asInt() < 0 ? "(" + std::to_string(v.asInt()) + ")" : std::to_string(v.asInt());
+    }
+    if (v.isBool()) return v.asBool() ? "true" : "false";
+    if (v.isChar()) return "char(" + std::to_string(static_cast<unsigned char>(v.asChar())) + ")";
+    if (v.isString()) {
+        // made once up front, not every time round a loop
+        int& index = stringConstant[e.constant];
+        if (index < 0) {
+            index = static_cast<int>(stringConstant.size() + 1); // anything unique
+            std::string_view text = v.asString();
+            constants += "static const std::string str" + std::to_string(e.constant) + "(" + quote(text) + ", "
+                       + std::to_string(text.size()) + ");\n";
+        }
+        return "str" + std::to_string(e.constant);
+    }
+    return "zen::Value()";
+}
+
+std::string CppGen::assignment(NodeId id) {
+    const auto& e = ast->get<AssignmentExpression>(id);
+    std::string name = mangle(e.name.lexeme, e.variable);
+    Type type = fromStatic(e.type);
+
+    // s = s + a + b appends in place instead of copying s every time, as
+    // long as a and b can't see the difference: they don't read or assign
+    // s, and can't fail halfway
+    if (type == Type::String) {
+        std::vector<NodeId> parts;
+        NodeId at = e.value;
+        while (kindOf(at) == NodeKind::Binary && ast->get<BinaryExpression>(at).op.type == PLUS
+               && typeOf(at) == Type::String) {
+            parts.push_back(ast->get<BinaryExpression>(at).right);
+            at = ast->get<BinaryExpression>(at).left;
+        }
+        bool inPlace = !parts.empty() && kindOf(at) == NodeKind::Identifier
+                    && ast->get<IdentifierExpression>(at).variable == e.variable;
+        for (NodeId part : parts) inPlace = inPlace && !assigns(part) && !fails(part) && !reads(part, e.variable);
+        if (inPlace) {
+            std::string text = "(";
+            for (size_t i = parts.size(); i-- > 0;) {
+                text += "zen::append(" + name + ", " + expression(parts[i]) + ")";
+                if (i > 0) text += ", ";
+            }
+            return text + ")";
+        }
+    }
+    return "(" + name + " = " + as(type, e.value) + ")";
+}
+
+std::string CppGen::binary(const BinaryExpression& e) {
+    Type left = typeOf(e.left);
+    Type right = typeOf(e.right);
+    std::string at = std::to_string(e.op.line);
+
+    if (e.op.type == AND || e.op.type == OR) {
+        if (left == Type::Bool && right == Type::Bool) {
+            return "(" + expression(e.left) + (e.op.type == AND ? " && " : " || ") + expression(e.right) + ")";
+        }
+        // the operand that decided it is the result, whatever its type
+        Type type = left == right ? left : Type::Dynamic;
+        std::string t = cppType(type);
+        return "[&]() -> " + t + " { " + t + " l = " + as(type, e.left) + "; if ("
+             + (e.op.type == AND ? "!" : "") + "zen::truthy(l)) return l; return " + as(type, e.right) + "; }()";
+    }
+
+    bool ints = left == Type::Int && right == Type::Int;
+    bool same = left == right && left != Type::Dynamic;
+    bool dynamic = !ints && !(e.op.type == PLUS && left == Type::String && right == Type::String)
+                && e.op.type != EQUAL_EQUAL && e.op.type != BANG_EQUAL;
+    Type operands = dynamic || ((e.op.type == EQUAL_EQUAL || e.op.type == BANG_EQUAL) && !same)
+                  ? Type::Dynamic : left;
+    std::string a = operands == Type::Dynamic ? as(Type::Dynamic, e.left) : expression(e.left);
+    std::string b = operands == Type::Dynamic ? as(Type::Dynamic, e.right) : expression(e.right);
+
+    // c++ doesn't promise to evaluate operands left to right. when it could
+    // tell (one assigns what the other reads, both can fail) they're named first
+    bool ordered = (assigns(e.right) && !isLiteral(e.left)) || (assigns(e.left) && !isLiteral(e.right))
+                || (fails(e.left) && fails(e.right));
+    std::string l = ordered ? "l" : a;
+    std::string r = ordered ? "r" : b;
+
+    std::string op;
+    auto call = [&](const char* name, bool withLine) {
+        return std::string("zen::") + name + "(" + l + ", " + r + (withLine ? ", " + at : "") + ")";
+    };
+    switch (e.op.type) {
+        case PLUS:
+            op = left == Type::String && right == Type::String ? call("concat", false) : call("add", !ints);
+            break;
+        case MINUS: op = call("sub", !ints); break;
+        case STAR:  op = call("mul", !ints); break;
+        case SLASH: op = call("divide", true); break;
+        case EQUAL_EQUAL:
+            op = same ? "(" + l + " == " + r + ")" : call("equal", false);
+            break;
+        case BANG_EQUAL:
+            op = same ? "(" + l + " != " + r + ")" : "(!" + call("equal", false) + ")";
+            break;
+        default: {
+            const char* symbol = e.op.type == GREATER ? " > " : e.op.type == GREATER_EQUAL ? " >= "
+                               : e.op.type == LESS ? " < " : " <= ";
+            const char* name = e.op.type == GREATER ? "greater" : e.op.type == GREATER_EQUAL ? "greaterEqual"
+                             : e.op.type == LESS ? "less" : "lessEqual";
+            if (!isComparison(e.op.type)) throw ScriptError("[ERROR] Unknown expression type.\n");
+            op = ints ? "(" + l + symbol + r + ")" : call(name, true);
+            break;
+        }
+    }
+    if (!ordered) return op;
+    return "[&] { auto l = " + a + "; auto r = " + b + "; return " + op + "; }()";
+}
+
+// whether evaluating expr can change a variable
+bool CppGen::assigns(NodeId id) const {
+    switch (kindOf(id)) {
+        case NodeKind::Assignment: return true;
+        case NodeKind::Unary:      return assigns(ast->get<UnaryExpression>(id).expr);
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            return assigns(e.left) || assigns(e.right);
+        }
+        default: return false;
+    }
+}
+
+// whether expr reads the variable
+bool CppGen::reads(NodeId id, uint32_t variable) const {
+    switch (kindOf(id)) {
+        case NodeKind::Identifier: return ast->get<IdentifierExpression>(id).variable == variable;
+        case NodeKind::Assignment: return reads(ast->get<AssignmentExpression>(id).value, variable);
+        case NodeKind::Unary:      return reads(ast->get<UnaryExpression>(id).expr, variable);
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            return reads(e.left, variable) || reads(e.right, variable);
+        }
+        default: return false;
+    }
+}
+
+// whether evaluating expr can raise an error
+bool CppGen::fails(NodeId id) const {
+    switch (kindOf(id)) {
+        case NodeKind::Assignment: return fails(ast->get<AssignmentExpression>(id).value);
+        case NodeKind::Unary: {
+            const auto& e = ast->get<UnaryExpression>(id);
+            return (e.op.type == MINUS && typeOf(e.expr) != Type::Int) || fails(e.expr);
+        }
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            bool ints = typeOf(e.left) == Type::Int && typeOf(e.right) == Type::Int;
+            switch (e.op.type) {
+                case AND: case OR: case EQUAL_EQUAL: case BANG_EQUAL:
+                    break;
+                case SLASH:
+                    return true;
+                default:
+                    // a string concat can fail too, if it gets past 4GB
+                    if (!ints) return true;
+                    break;
+            }
+            return fails(e.left) || fails(e.right);
+        }
+        default: return false;
+    }
+}
+
+const char* CppGen::cppType(Type type) {
+    switch (type) {
+        case Type::Int:    return "int";
+        case Type::Bool:   return "bool";
+        case Type::Char:   return "char";
+        case Type::String: return "std::string";
+        default:           return "zen::Value";
+    }
+}
+
+CppGen::Type CppGen::fromStatic(StaticType type) {
+    switch (type) {
+        case StaticType::Int:    return Type::Int;
+        case StaticType::Bool:   return Type::Bool;
+        case StaticType::Char:   return Type::Char;
+        case StaticType::String: return Type::String;
+        default:                 return Type::Dynamic;
+    }
+}
+
+// files
+
+void writeCpp(const std::string& cppPath, const std::string& code) {
+    size_t slash = cppPath.find_last_of("/\\");
+    std::string runtimePath = (slash == std::string::npos ? "" : cppPath.substr(0, slash + 1)) + CPP_RUNTIME_NAME;
+    auto write = [](const std::string& path, std::string_view text) {
+        std::ofstream out(path, std::ios::binary);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.close();
+        if (!out) throw ScriptError("[ERROR] Could not write '" + path + "'\n");
+    };
+    write(cppPath, code);
+    write(runtimePath, CPP_RUNTIME);
+}
+
+int buildCpp(const std::string& cppPath) {
+    size_t slash = cppPath.find_last_of("/\\");
+    size_t dot = cppPath.find_last_of('.');
+    std::string exe = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+                    ? cppPath.substr(0, dot) : cppPath + ".out";
+    const char* compiler = std::getenv("CXX");
+    if (!compiler || !*compiler) compiler = "c++";
+
+#ifndef _WIN32
+    std::vector<std::string> args = {compiler, "-std=c++17", "-O2", "-o", exe, cppPath};
+    std::vector<char*> argv;
+    for (auto& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, compiler, nullptr, nullptr, argv.data(), environ) != 0) {
+        std::cerr << "[ERROR] Could not run the compiler '" << compiler << "'\n";
+        return 1;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return 1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+#else
+    std::string command = std::string("\"") + compiler + "\" -std=c++17 -O2 -o \"" + exe + "\" \"" + cppPath + "\"";
+    return std::system(command.c_str()) == 0 ? 0 : 1;
+#endif
+}
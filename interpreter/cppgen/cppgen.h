@@ -0,0 +1,65 @@
+#ifndef CPPGEN_H
+#define CPPGEN_H
+
+#include "interpreter/parser/ast.h"
+#include <string>
+#include <vector>
+
+// --emit-cpp: translates a whole program into one c++ function, ahead of
+// time. expects the same resolved, checked and folded ast the compiler gets.
+//
+// every variable is declared with its type, so most of the program
+// translates straight to plain ints, bools and std::strings with no tags and
+// no checks. a variable that's ever assigned a value of another type, and
+// anything mixing types, falls back to zen::Value, which checks at run time
+// like the interpreter does. the output includes zenith_runtime.h, which has
+// the error messages, the display format and the division checks, so the
+// result behaves exactly like `zenith script.zen`.
+class CppGen {
+    public:
+        // source is only named in a comment at the top
+        std::string generate(const Ast& ast, const std::string& source);
+
+    private:
+        enum class Type : uint8_t { Int, Bool, Char, String, Dynamic };
+
+        const Ast* ast = nullptr;
+        // string literals become constants, by ast constant index
+        std::vector<int> stringConstant;
+        std::string constants;
+        std::string body;
+
+        // statements
+        void statement(NodeId stmt, int indent);
+        void block(NodeId stmt, int indent);
+        void ifChain(NodeId stmt, int indent, const std::string& prefix);
+        void line(int indent, const std::string& text);
+
+        // expressions, text comes back with its static type
+        Type typeOf(NodeId expr) const;
+        std::string expression(NodeId expr);
+        std::string binary(const BinaryExpression& e);
+        std::string assignment(NodeId id);
+        std::string literal(const LiteralExpression& e);
+        std::string as(Type type, NodeId expr);
+
+        bool assigns(NodeId expr) const;
+        bool fails(NodeId expr) const;
+        bool reads(NodeId expr, uint32_t variable) const;
+
+        static const char* cppType(Type type);
+        static Type fromStatic(StaticType type);
+};
+
+// the contents of zenith_runtime.h, written next to every generated file
+extern const char* const CPP_RUNTIME;
+constexpr const char* CPP_RUNTIME_NAME = "zenith_runtime.h";
+
+// writes cppPath and the runtime header beside it. throws ScriptError
+void writeCpp(const std::string& cppPath, const std::string& code);
+
+// --build: compiles cppPath with $CXX (c++ without it) into an executable
+// named after it without the extension. returns the compiler's exit status
+int buildCpp(const std::string& cppPath);
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef ZENITH_RUNTIME_H
+#define ZENITH_RUNTIME_H
+
+// what programs translated by `zenith --emit-cpp` run on. zenith writes
+// this file next to the generated .cpp, it has no other dependencies.
+//
+// everything a script does that can fail or print goes through here, so it
+// fails and prints exactly like the interpreter: same error text, same line
+// numbers, same output format, ints that wrap instead of being undefined.
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace zen {
+
+// what the interpreter would print to stderr before exiting with 1
+struct Error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] inline void typeError(int line, const char* msg) {
+    throw Error("[line " + std::to_string(line) + "] TYPE ERROR: " + msg + "\n");
+}
+
+[[noreturn]] inline void mismatch(int line) {
+    typeError(line, "Type mismatch in variable declaration.");
+}
+
+// ints
+
+inline int add(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+inline int sub(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+inline int mul(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+inline int neg(int a)        { return static_cast<int>(0u - static_cast<uint32_t>(a)); }
+
+inline int divide(int a, int b, int line) {
+    if (b == 0) typeError(line, "Division by zero.");
+    // the one quotient that overflows, INT_MIN / -1 wraps back to INT_MIN
+    if (b == -1) return neg(a);
+    return a / b;
+}
+
+// strings
+
+inline void checkLength(size_t a, size_t b) {
+    if (static_cast<uint64_t>(a) + b > UINT32_MAX) throw Error("[ERROR] String too long.\n");
+}
+
+inline std::string concat(const std::string& a, const std::string& b) {
+    checkLength(a.size(), b.size());
+    std::string s;
+    s.reserve(a.size() + b.size());
+    s += a;
+    s += b;
+    return s;
+}
+
+// s = s + b, in place
+inline const std::string& append(std::string& s, const std::string& b) {
+    checkLength(s.size(), b.size());
+    return s += b;
+}
+
+// a value whose type is only known at run time: variables assigned more
+// than one type, and whatever mixes them
+struct Value {
+    std::variant<std::monostate, int, bool, char, std::string> v;
+
+    Value() = default;
+    Value(int i) : v(i) {}
+    Value(bool b) : v(b) {}
+    Value(char c) : v(c) {}
+    Value(std::string s) : v(std::move(s)) {}
+
+    bool isInt() const    { return std::holds_alternative<int>(v); }
+    bool isString() const { return std::holds_alternative<std::string>(v); }
+    int asInt() const     { return std::get<int>(v); }
+    const std::string& asString() const { return std::get<std::string>(v); }
+};
+
+inline bool truthy(int)         { return true; }
+inline bool truthy(bool b)      { return b; }
+inline bool truthy(char)        { return true; }
+inline bool truthy(const std::string&) { return true; }
+inline bool truthy(const Value& a) {
+    if (auto* b = std::get_if<bool>(&a.v)) return *b;
+    return !std::holds_alternative<std::monostate>(a.v);
+}
+
+inline bool equal(const Value& a, const Value& b) { return a.v == b.v; }
+
+inline Value add(const Value& a, const Value& b, int line) {
+    if (a.isInt() && b.isInt()) return add(a.asInt(), b.asInt());
+    if (a.isString() && b.isString()) return concat(a.asString(), b.asString());
+    typeError(line, "Operands of '+' must both be int or both be string.");
+}
+
+#define ZENITH_INT_OPERANDS(symbol) \
+    if (!a.isInt() || !b.isInt()) typeError(line, "Operands of '" symbol "' must be int.")
+
+inline int sub(const Value& a, const Value& b, int line)    { ZENITH_INT_OPERANDS("-"); return sub(a.asInt(), b.asInt()); }
+inline int mul(const Value& a, const Value& b, int line)    { ZENITH_INT_OPERANDS("*"); return mul(a.asInt(), b.asInt()); }
+inline int divide(const Value& a, const Value& b, int line) { ZENITH_INT_OPERANDS("/"); return divide(a.asInt(), b.asInt(), line); }
+inline bool greater(const Value& a, const Value& b, int line)      { ZENITH_INT_OPERANDS(">");  return a.asInt() > b.asInt(); }
+inline bool greaterEqual(const Value& a, const Value& b, int line) { ZENITH_INT_OPERANDS(">="); return a.asInt() >= b.asInt(); }
+inline bool less(const Value& a, const Value& b, int line)         { ZENITH_INT_OPERANDS("<");  return a.asInt() < b.asInt(); }
+inline bool lessEqual(const Value& a, const Value& b, int line)    { ZENITH_INT_OPERANDS("<="); return a.asInt() <= b.asInt(); }
+
+#undef ZENITH_INT_OPERANDS
+
+inline int negate(const Value& a, int line) {
+    if (!a.isInt()) typeError(line, "Operand of '-' must be an int.");
+    return neg(a.asInt());
+}
+
+// the initialiser of a T variable, checked
+template <typename T>
+T declared(Value a, int line) {
+    if (auto* t = std::get_if<T>(&a.v)) return std::move(*t);
+    mismatch(line);
+}
+
+// same, for a variable that's later assigned other types
+template <typename T>
+Value checked(Value a, int line) {
+    if (!std::holds_alternative<T>(a.v)) mismatch(line);
+    return a;
+}
+
+// display(), stdout is buffered like the interpreter's
+
+inline void write(const char* text, size_t size) { std::fwrite(text, 1, size, stdout); }
+
+inline void display(int i) {
+    char text[12];
+    auto result = std::to_chars(text, text + 11, i);
+    *result.ptr++ = '\n';
+    write(text, static_cast<size_t>(result.ptr - text));
+}
+inline void display(bool b) { b ? write("true\n", 5) : write("false\n", 6); }
+inline void display(char c) {
+    char text[2] = {c, '\n'};
+    write(text, 2);
+}
+inline void display(const std::string& s) {
+    write(s.data(), s.size());
+    write("\n", 1);
+}
+inline void display(const Value& a) {
+    std::visit([](const auto& x) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(x)>, std::monostate>) write("null\n", 5);
+        else display(x);
+    }, a.v);
+}
+
+// runs the translated program, errors end it the way they end zenith
+inline int main(void (*program)()) {
+    try {
+        program();
+    } catch (const Error& e) {
+        std::fflush(stdout);
+        std::fputs(e.what(), stderr);
+        return 1;
+    }
+    std::fflush(stdout);
+    return 0;
+}
+
+} // namespace zen
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <stdexcept>
+#include <string>
+
+// anything wrong with a script, from a stray character to a type error at
+// run time. what() is the whole report, one or more lines each ending in a
+// newline. nothing below main prints errors or exits: whoever ran the
+// script catches this, flushes the script's output so it comes first, and
+// decides where the report goes. that's what lets --jobs run many scripts
+// in one process without a bad one taking the rest down.
+class ScriptError : public std::runtime_error {
+    public:
+        explicit ScriptError(const std::string& report) : std::runtime_error(report) {}
+};
+
+#endif
@@ -1,279 +1,257 @@
 #include "evaluator.h"
-#include <iostream>
-#include <cstdlib>
-#include <stdexcept>
-
-// helpers 
-
-std::string valueToString(const Value& v) {
-    return std::visit([](auto&& val) -> std::string {
-        using T = std::decay_t<decltype(val)>;
-        if constexpr (std::is_same_v<T, int>)         return std::to_string(val);
-        if constexpr (std::is_same_v<T, bool>)        return val ? "true" : "false";
-        if constexpr (std::is_same_v<T, std::string>) return val;
-        if constexpr (std::is_same_v<T, char>)        return std::string(1, val);
-        if constexpr (std::is_same_v<T, std::monostate>) return "null";
-    }, v);
-}
-
-void printValue(const Value& v) {
-    std::cout << valueToString(v) << "\n";
-}
-
-// env
-// all errors rage quit for now, i don't know if i'll rework that
-
-void Environment::define(const std::string& name, Value value) {
-    if (values.count(name)) {
-        std::cerr << "[ERROR] Redeclaration of variable '" << name << "'.\n";
-        std::exit(1);
-    }
-    values[name] = std::move(value);
-}
-
-Value Environment::get(const std::string& name, int line) const {
-    auto it = values.find(name);
-    if (it != values.end()) return it->second;
-    if (enclosing) return enclosing->get(name, line);
-
-    std::cerr << "[line " << line << "] ERROR: Undefined variable '" << name << "'.\n";
-    std::exit(1);
-}
-
-void Environment::assign(const std::string& name, Value value, int line) {
-    auto it = values.find(name);
-    if (it != values.end()) {
-        it->second = std::move(value);
-        return;
-    }
-    if (enclosing) {
-        enclosing->assign(name, std::move(value), line);
-        return;
-    }
-    std::cerr << "[line " << line << "] ERROR: Undefined variable '" << name << "'.\n";
-    std::exit(1);
-}
+#include "interpreter/error.h"
+#include <string>
 
 // eval
 
 void Evaluator::typeError(const std::string& msg, int line) {
-    std::cerr << "[line " << line << "] TYPE ERROR: " << msg << "\n";
-    std::exit(1);
-}
-
-bool Evaluator::isTruthy(const Value& v) {
-    if (std::holds_alternative<bool>(v))        return std::get<bool>(v);
-    if (std::holds_alternative<std::monostate>(v)) return false;
-    return true;  // everything else is truthy
-}
-
-bool Evaluator::isEqual(const Value& a, const Value& b) {
-    return a == b;
+    throw ScriptError("[line " + std::to_string(line) + "] TYPE ERROR: " + msg + "\n");
 }
 
 void Evaluator::checkTypeMatch(TokenType declared, const Value& val, int line) {
-    bool valid = false;
-    switch (declared) {
-        case TYPE_INT:    valid = std::holds_alternative<int>(val);         break;
-        case TYPE_STRING: valid = std::holds_alternative<std::string>(val); break;
-        case TYPE_BOOL:   valid = std::holds_alternative<bool>(val);        break;
-        case TYPE_CHAR:   valid = std::holds_alternative<char>(val);        break;
-        default: break;
-    }
-    if (!valid) {
+    if (!valueMatchesType(declared, val)) {
         typeError("Type mismatch in variable declaration.", line);
     }
 }
 
 // run.
 
-void Evaluator::run(const std::vector<std::unique_ptr<Statement>>& statements) {
-    for (const auto& stmt : statements) {
-        execute(*stmt);
+void Evaluator::run(const Ast& program, int globals) {
+    ast = &program;
+    env.pushScope(globals);
+    if (profiler) {
+        profiler->start();
+        runStatements<Instrument::Profile>();
+        profiler->stop();
+    } else if (sampler) {
+        runStatements<Instrument::Sample>();
+    } else {
+        runStatements<Instrument::None>();
     }
+    env.popScope();
 }
 
-// actual execution stuff
+template <Instrument I>
+void Evaluator::runStatements() {
+    const auto& statements = ast->statements;
+    for (size_t i = 0; i < statements.size(); i++) {
+        if (tracer) tracer->mark(static_cast<uint32_t>(i));
+        execute<I>(statements[i]);
+    }
+}
 
-void Evaluator::execute(const Statement& stmt) {
+// actual execution stuff
 
-    if (const auto* s = dynamic_cast<const PrintStatement*>(&stmt)) {
-        Value val = evaluate(*s->expr);
-        printValue(val);
-        return;
+template <Instrument I>
+void Evaluator::execute(NodeId id) {
+    if constexpr (I == Instrument::Profile) {
+        auto entered = profiler->enter(id);
+        executeStatement<I>(id);
+        profiler->exit(id, entered);
+    } else if constexpr (I == Instrument::Sample) {
+        // one store, ifs and loops push themselves below
+        sampler->at(id);
+        executeStatement<I>(id);
+    } else {
+        executeStatement<I>(id);
     }
+}
 
-    if (const auto* s = dynamic_cast<const VarDeclStatement*>(&stmt)) {
-        Value val = evaluate(*s->initialiser);
-        checkTypeMatch(s->typeKeyword, val, s->name.line);
-        env->define(std::string(s->name.lexeme), std::move(val));
-        return;
-    }
+template <Instrument I>
+void Evaluator::executeStatement(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Print: {
+            Value val = evaluate(ast->get<PrintStatement>(id).expr);
+            out.display(val);
+            return;
+        }
 
-    if (const auto* s = dynamic_cast<const BlockStatement*>(&stmt)) {
-        Environment blockEnv(env);
-        executeBlock(*s, &blockEnv);
-        return;
-    }
+        case NodeKind::VarDecl: {
+            const auto& s = ast->get<VarDeclStatement>(id);
+            Value val = evaluate(s.initialiser);
+            checkTypeMatch(s.typeKeyword, val, s.name.line);
+            env.at(0, s.slot) = std::move(val);
+            return;
+        }
 
-    if (const auto* s = dynamic_cast<const IfStatement*>(&stmt)) {
-        Value cond = evaluate(*s->condition);
-        if (isTruthy(cond)) {
-            execute(*s->thenBranch);
-        } else if (s->elseBranch) {
-            execute(*s->elseBranch);
+        case NodeKind::Block:
+            executeBlock<I>(ast->get<BlockStatement>(id));
+            return;
+
+        case NodeKind::If: {
+            const auto& s = ast->get<IfStatement>(id);
+            Value cond = evaluate(s.condition);
+            if constexpr (I == Instrument::Sample) sampler->push(id);
+            if (isTruthy(cond)) {
+                execute<I>(s.thenBranch);
+            } else if (s.elseBranch != NO_NODE) {
+                execute<I>(s.elseBranch);
+            }
+            if constexpr (I == Instrument::Sample) sampler->pop();
+            return;
         }
-        return;
-    }
 
-    if (const auto* s = dynamic_cast<const WhileStatement*>(&stmt)) {
-        while (isTruthy(evaluate(*s->condition))) {
-            execute(*s->body);
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            if constexpr (I == Instrument::Sample) sampler->push(id);
+            while (isTruthy(evaluate(s.condition))) {
+                execute<I>(s.body);
+                // the condition is the loop's, not the body's last statement's
+                if constexpr (I == Instrument::Sample) sampler->at(id);
+            }
+            if constexpr (I == Instrument::Sample) sampler->pop();
+            return;
         }
-        return;
-    }
 
-    if (const auto* s = dynamic_cast<const ForStatement*>(&stmt)) {
-        // init runs once
-        evaluate(*s->init);
-        while (isTruthy(evaluate(*s->condition))) {
-            execute(*s->body);
-            evaluate(*s->increment);
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            // init runs once
+            evaluate(s.init);
+            if constexpr (I == Instrument::Sample) sampler->push(id);
+            while (isTruthy(evaluate(s.condition))) {
+                execute<I>(s.body);
+                if constexpr (I == Instrument::Sample) sampler->at(id);
+                evaluate(s.increment);
+            }
+            if constexpr (I == Instrument::Sample) sampler->pop();
+            return;
         }
-        return;
-    }
 
-    if (const auto* s = dynamic_cast<const ExpressionStatement*>(&stmt)) {
-        evaluate(*s->expr);
-        return;
+        case NodeKind::ExpressionStmt:
+            evaluate(ast->get<ExpressionStatement>(id).expr);
+            return;
+
+        default:
+            break;
     }
 
     // how did we get here? 
-    std::cerr << "[ERROR] Unknown statement type.\n";
-    std::exit(1);
+    throw ScriptError("[ERROR] Unknown statement type.\n");
 }
 
-void Evaluator::executeBlock(const BlockStatement& block, Environment* blockEnv) {
-    Environment* previous = env;
-    env = blockEnv;
-    for (const auto& stmt : block.statements) {
-        execute(*stmt);
+template <Instrument I>
+void Evaluator::executeBlock(const BlockStatement& block) {
+    env.pushScope(block.slotCount);
+    for (const NodeId* it = ast->begin(block); it != ast->end(block); ++it) {
+        execute<I>(*it);
     }
-    env = previous;
+    env.popScope();
 }
 
 // expressions
 
-Value Evaluator::evaluate(const Expression& expr) {
+Value Evaluator::evaluate(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Literal:
+            return ast->constants[ast->get<LiteralExpression>(id).constant];
+
+        case NodeKind::Identifier: {
+            const auto& e = ast->get<IdentifierExpression>(id);
+            return env.at(e.depth, e.slot);
+        }
+
+        case NodeKind::Assignment: {
+            const auto& e = ast->get<AssignmentExpression>(id);
+            Value val = evaluate(e.value);
+            env.at(e.depth, e.slot) = val;
+            return val;
+        }
 
-    if (const auto* e = dynamic_cast<const LiteralExpression*>(&expr)) {
-        switch (e->op.type) {
-            case NUMBER: return std::stoi(std::string(e->op.lexeme));
-            case STRING: {
-                std::string s = std::string(e->op.lexeme);
-                return s.substr(1, s.size() - 2); // remove quotes
+        case NodeKind::Unary: {
+            const auto& e = ast->get<UnaryExpression>(id);
+            Value right = evaluate(e.expr);
+            switch (e.op.type) {
+                case MINUS:
+                    if (!right.isInt())
+                        typeError("Operand of '-' must be an int.", e.op.line);
+                    return negateInt(right.asInt());
+                case BANG:
+                    return !isTruthy(right);
+                default: break;
             }
-            case TRUE:  return true;
-            case FALSE: return false;
-            case NIL:   return std::monostate{};
-            default: break;
+            break;
         }
-    }
 
-    if (const auto* e = dynamic_cast<const IdentifierExpression*>(&expr)) {
-        return env->get(std::string(e->name.lexeme), e->name.line);
-    }
+        case NodeKind::Binary:
+            return evaluateBinary(ast->get<BinaryExpression>(id));
 
-    if (const auto* e = dynamic_cast<const AssignmentExpression*>(&expr)) {
-        Value val = evaluate(*e->value);
-        env->assign(std::string(e->name.lexeme), val, e->name.line);
-        return val;
+        default:
+            break;
     }
 
-    if (const auto* e = dynamic_cast<const UnaryExpression*>(&expr)) {
-        Value right = evaluate(*e->expr);
-        switch (e->op.type) {
-            case MINUS:
-                if (!std::holds_alternative<int>(right))
-                    typeError("Operand of '-' must be an int.", e->op.line);
-                return -std::get<int>(right);
-            case BANG:
-                return !isTruthy(right);
-            default: break;
-        }
+    // how did we get here?
+    throw ScriptError("[ERROR] Unknown expression type.\n");
+}
+
+Value Evaluator::evaluateBinary(const BinaryExpression& e) {
+    // short circuit logical operators before evaluating right
+    if (e.op.type == AND) {
+        Value left = evaluate(e.left);
+        if (!isTruthy(left)) return left;
+        return evaluate(e.right);
+    }
+    if (e.op.type == OR) {
+        Value left = evaluate(e.left);
+        if (isTruthy(left)) return left;
+        return evaluate(e.right);
     }
 
-    if (const auto* e = dynamic_cast<const BinaryExpression*>(&expr)) {
-        // short circuit logical operators before evaluating right
-        if (e->op.type == AND) {
-            Value left = evaluate(*e->left);
-            if (!isTruthy(left)) return left;
-            return evaluate(*e->right);
-        }
-        if (e->op.type == OR) {
-            Value left = evaluate(*e->left);
-            if (isTruthy(left)) return left;
-            return evaluate(*e->right);
-        }
+    Value left  = evaluate(e.left);
+    Value right = evaluate(e.right);
+    int line = e.op.line;
+
+    switch (e.op.type) {
+        case PLUS:
+            if (left.isInt() && right.isInt())
+                return addInt(left.asInt(), right.asInt());
+            if (left.isString() && right.isString())
+                return concat(left, right);
+            typeError("Operands of '+' must both be int or both be string.", line);
+            break;
+
+        case MINUS:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '-' must be int.", line);
+            return subtractInt(left.asInt(), right.asInt());
+
+        case STAR:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '*' must be int.", line);
+            return multiplyInt(left.asInt(), right.asInt());
+
+        case SLASH:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '/' must be int.", line);
+            if (right.asInt() == 0)
+                typeError("Division by zero.", line);
+            return divideInt(left.asInt(), right.asInt());
+
+        case GREATER:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '>' must be int.", line);
+            return left.asInt() > right.asInt();
+
+        case GREATER_EQUAL:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '>=' must be int.", line);
+            return left.asInt() >= right.asInt();
+
+        case LESS:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '<' must be int.", line);
+            return left.asInt() < right.asInt();
+
+        case LESS_EQUAL:
+            if (!left.isInt() || !right.isInt())
+                typeError("Operands of '<=' must be int.", line);
+            return left.asInt() <= right.asInt();
+
+        case EQUAL_EQUAL: return isEqual(left, right);
+        case BANG_EQUAL:  return !isEqual(left, right);
 
-        Value left  = evaluate(*e->left);
-        Value right = evaluate(*e->right);
-        int line = e->op.line;
-
-        switch (e->op.type) {
-            case PLUS:
-                if (std::holds_alternative<int>(left) && std::holds_alternative<int>(right))
-                    return std::get<int>(left) + std::get<int>(right);
-                if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right))
-                    return std::get<std::string>(left) + std::get<std::string>(right);
-                typeError("Operands of '+' must both be int or both be string.", line);
-                break;
-
-            case MINUS:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '-' must be int.", line);
-                return std::get<int>(left) - std::get<int>(right);
-
-            case STAR:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '*' must be int.", line);
-                return std::get<int>(left) * std::get<int>(right);
-
-            case SLASH:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '/' must be int.", line);
-                if (std::get<int>(right) == 0)
-                    typeError("Division by zero.", line);
-                return std::get<int>(left) / std::get<int>(right);
-
-            case GREATER:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '>' must be int.", line);
-                return std::get<int>(left) > std::get<int>(right);
-
-            case GREATER_EQUAL:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '>=' must be int.", line);
-                return std::get<int>(left) >= std::get<int>(right);
-
-            case LESS:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '<' must be int.", line);
-                return std::get<int>(left) < std::get<int>(right);
-
-            case LESS_EQUAL:
-                if (!std::holds_alternative<int>(left) || !std::holds_alternative<int>(right))
-                    typeError("Operands of '<=' must be int.", line);
-                return std::get<int>(left) <= std::get<int>(right);
-
-            case EQUAL_EQUAL: return isEqual(left, right);
-            case BANG_EQUAL:  return !isEqual(left, right);
-
-            default: break;
-        }
+        default: break;
     }
 
     // how did we get here?
-    std::cerr << "[ERROR] Unknown expression type.\n";
-    std::exit(1);
-}
\ No newline at end of file
+    throw ScriptError("[ERROR] Unknown expression type.\n");
+}
@@ -1,53 +1,85 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
-#include "interpreter/parser/parser.h"
+#include "interpreter/parser/ast.h"
 #include "interpreter/token.h"
-#include <variant>
+#include "interpreter/value.h"
+#include "interpreter/output.h"
+#include "interpreter/profiler/profiler.h"
+#include "interpreter/profiler/sampler.h"
+#include "interpreter/profiler/trace.h"
 #include <string>
-#include <unordered_map>
-#include <memory>
 #include <vector>
 #include <iostream>
 
-using Value = std::variant<int, bool, std::string, char, std::monostate>;
-
-std::string valueToString(const Value& v);
-void printValue(const Value& v);
-
+// every scope's slots live back to back in one array, scopes just remember
+// where they start. the resolver already worked out which slot a name is in
 class Environment {
     public:
-        Environment() : enclosing(nullptr) {}
-        Environment(Environment* enclosing) : enclosing(enclosing) {}
+        void pushScope(int slotCount) {
+            scopes.push_back(values.size());
+            values.resize(values.size() + slotCount);
+            scopesEntered++;
+            if (scopes.size() > peakDepth) peakDepth = scopes.size();
+        }
 
-        void define(const std::string& name, Value value);
+        void popScope() {
+            values.resize(scopes.back());
+            scopes.pop_back();
+        }
 
-        Value get(const std::string& name, int line) const;
+        Value& at(int depth, int slot) {
+            return values[scopes[scopes.size() - 1 - depth] + slot];
+        }
+
+        // for --stats
+        size_t scopesEntered = 0;
+        size_t peakDepth = 0;
 
-        void assign(const std::string& name, Value value, int line);
-    
     private:
-        std::unordered_map<std::string, Value> values;
-        Environment* enclosing;
+        std::vector<Value> values;
+        std::vector<size_t> scopes;
 };
 
+// which copy of the statement loop runs, see setProfiler and setSampler
+enum class Instrument { None, Profile, Sample };
+
 class Evaluator {
     public:
-        Evaluator() : env(new Environment()) {}
+        explicit Evaluator(Output& out = standardOutput()) : out(out) {}
+
+        // globals is the top level slot count from the resolver
+        void run(const Ast& ast, int globals);
 
-        void run(const std::vector<std::unique_ptr<Statement>>& statements);
+        // time every statement into profiler while running. the timing
+        // code is compiled into its own copy of the statement loop, so
+        // runs without a profiler don't even branch on it
+        void setProfiler(Profiler* p) { profiler = p; }
+        // keep sampler's statement stack up to date for --sample-profile,
+        // same deal, its own copy of the loop
+        void setSampler(Sampler* s) { sampler = s; }
+        // report each top level statement to tracer as it starts
+        void setTracer(Tracer* t) { tracer = t; }
+
+        const Environment& environment() const { return env; }
     
     private:
-        Environment* env;
-        
-        void execute(const Statement& stmt);
-        void executeBlock(const BlockStatement& stmt, Environment* blockEnv);
+        Output& out;
+        const Ast* ast = nullptr;
+        Environment env;
+        Profiler* profiler = nullptr;
+        Sampler* sampler = nullptr;
+        Tracer* tracer = nullptr;
+
+        template <Instrument I> void runStatements();
+        template <Instrument I> void execute(NodeId stmt);
+        template <Instrument I> void executeStatement(NodeId stmt);
+        template <Instrument I> void executeBlock(const BlockStatement& stmt);
 
-        Value evaluate(const Expression& expr);
+        Value evaluate(NodeId expr);
+        Value evaluateBinary(const BinaryExpression& expr);
 
-        void typeError(const std::string& msg, int line);
-        bool isTruthy(const Value& v);
-        bool isEqual(const Value& a, const Value& b);
+        [[noreturn]] void typeError(const std::string& msg, int line);
         void checkTypeMatch(TokenType declared, const Value& val, int line);
 };
 
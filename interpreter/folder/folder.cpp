@@ -0,0 +1,196 @@
+#include "folder.h"
+#include <climits>
+#include <cstdint>
+#include <string>
+
+namespace {
+
+// int ops are done wide and only kept if they fit
+bool fitsInt(int64_t v) {
+    return v >= INT_MIN && v <= INT_MAX;
+}
+
+bool evalBinary(TokenType op, const Value& left, const Value& right, Interner& interner, Value& out) {
+    if (op == EQUAL_EQUAL) { out = isEqual(left, right);  return true; }
+    if (op == BANG_EQUAL)  { out = !isEqual(left, right); return true; }
+
+    // folded strings are interned like the literals they came from
+    if (op == PLUS && left.isString() && right.isString()) {
+        std::string text(left.asString());
+        text.append(right.asString());
+        out = Value::interned(interner, interner.intern(text));
+        return true;
+    }
+
+    if (!left.isInt() || !right.isInt()) return false;
+    int64_t a = left.asInt();
+    int64_t b = right.asInt();
+    int64_t result = 0;
+
+    switch (op) {
+        case PLUS:          result = a + b; break;
+        case MINUS:         result = a - b; break;
+        case STAR:          result = a * b; break;
+        case SLASH:
+            if (b == 0) return false;
+            result = a / b;
+            break;
+        case GREATER:       out = a > b;  return true;
+        case GREATER_EQUAL: out = a >= b; return true;
+        case LESS:          out = a < b;  return true;
+        case LESS_EQUAL:    out = a <= b; return true;
+        default:            return false;
+    }
+
+    if (!fitsInt(result)) return false;
+    out = static_cast<int>(result);
+    return true;
+}
+
+} // namespace
+
+void Folder::fold(Ast& program) {
+    ast = &program;
+    size_t kept = 0;
+    for (NodeId stmt : program.statements) {
+        NodeId folded = foldStatement(stmt);
+        if (folded != NO_NODE) program.statements[kept++] = folded;
+    }
+    program.statements.resize(kept);
+}
+
+// statements
+
+NodeId Folder::foldStatement(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Print: {
+            NodeId expr = foldExpression(ast->get<PrintStatement>(id).expr);
+            ast->get<PrintStatement>(id).expr = expr;
+            return id;
+        }
+
+        case NodeKind::VarDecl: {
+            NodeId init = foldExpression(ast->get<VarDeclStatement>(id).initialiser);
+            ast->get<VarDeclStatement>(id).initialiser = init;
+            return id;
+        }
+
+        case NodeKind::Block: {
+            // compact the block's run in place, dropped statements leave no gap
+            auto& s = ast->get<BlockStatement>(id);
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < s.count; i++) {
+                NodeId folded = foldStatement(ast->lists[s.first + i]);
+                if (folded != NO_NODE) ast->lists[s.first + kept++] = folded;
+            }
+            s.count = kept;
+            return id;
+        }
+
+        case NodeKind::If: {
+            auto& s = ast->get<IfStatement>(id);
+            s.condition = foldExpression(s.condition);
+            s.thenBranch = foldStatement(s.thenBranch);
+            if (s.elseBranch != NO_NODE) s.elseBranch = foldStatement(s.elseBranch);
+
+            // if (true) is just its block, if (false) is just its else
+            if (const Value* cond = constantOf(s.condition))
+                return isTruthy(*cond) ? s.thenBranch : s.elseBranch;
+            return id;
+        }
+
+        case NodeKind::While: {
+            auto& s = ast->get<WhileStatement>(id);
+            s.condition = foldExpression(s.condition);
+            s.body = foldStatement(s.body);
+
+            if (const Value* cond = constantOf(s.condition))
+                if (!isTruthy(*cond)) return NO_NODE;
+            return id;
+        }
+
+        case NodeKind::For: {
+            // init always runs, so the loop can't be dropped even if the condition is false
+            auto& s = ast->get<ForStatement>(id);
+            s.init = foldExpression(s.init);
+            s.condition = foldExpression(s.condition);
+            s.increment = foldExpression(s.increment);
+            s.body = foldStatement(s.body);
+            return id;
+        }
+
+        case NodeKind::ExpressionStmt: {
+            NodeId expr = foldExpression(ast->get<ExpressionStatement>(id).expr);
+            ast->get<ExpressionStatement>(id).expr = expr;
+            return id;
+        }
+
+        default:
+            return id;
+    }
+}
+
+// expressions
+
+NodeId Folder::foldExpression(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Assignment: {
+            NodeId value = foldExpression(ast->get<AssignmentExpression>(id).value);
+            ast->get<AssignmentExpression>(id).value = value;
+            return id;
+        }
+
+        case NodeKind::Unary:  return foldUnary(id);
+        case NodeKind::Binary: return foldBinary(id);
+
+        default:
+            return id;
+    }
+}
+
+NodeId Folder::foldUnary(NodeId id) {
+    NodeId operand = foldExpression(ast->get<UnaryExpression>(id).expr);
+    ast->get<UnaryExpression>(id).expr = operand;
+
+    const Value* value = constantOf(operand);
+    if (!value) return id;
+
+    Token op = ast->get<UnaryExpression>(id).op;
+    switch (op.type) {
+        case MINUS:
+            if (!value->isInt() || value->asInt() == INT_MIN) return id;
+            return ast->addLiteral(op, -value->asInt());
+        case BANG:
+            return ast->addLiteral(op, !isTruthy(*value));
+        default:
+            return id;
+    }
+}
+
+NodeId Folder::foldBinary(NodeId id) {
+    NodeId left = foldExpression(ast->get<BinaryExpression>(id).left);
+    NodeId right = foldExpression(ast->get<BinaryExpression>(id).right);
+    auto& e = ast->get<BinaryExpression>(id);
+    e.left = left;
+    e.right = right;
+
+    const Value* l = constantOf(left);
+    if (!l) return id;
+
+    // a constant left side decides and/or by itself, whatever the right is
+    if (e.op.type == AND) return isTruthy(*l) ? right : left;
+    if (e.op.type == OR)  return isTruthy(*l) ? left : right;
+
+    const Value* r = constantOf(right);
+    if (!r) return id;
+
+    Value result;
+    if (!evalBinary(e.op.type, *l, *r, interner, result)) return id;
+    Token op = e.op;
+    return ast->addLiteral(op, std::move(result));
+}
+
+const Value* Folder::constantOf(NodeId expr) const {
+    if (expr == NO_NODE || kindOf(expr) != NodeKind::Literal) return nullptr;
+    return &ast->constants[ast->get<LiteralExpression>(expr).constant];
+}
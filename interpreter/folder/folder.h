@@ -0,0 +1,35 @@
+#ifndef FOLDER_H
+#define FOLDER_H
+
+#include "interpreter/parser/ast.h"
+#include "interpreter/interner.h"
+
+// collapses operators whose operands are all literals into a single literal,
+// and drops if/while branches whose condition is a literal. runs after the
+// resolver and the checker so dead branches still get their errors reported.
+//
+// anything that would fail at runtime (division by zero, mixed types,
+// overflow) is left alone so it still fails at runtime, on the right line.
+class Folder {
+    public:
+        // folded strings get interned alongside the program's literals
+        explicit Folder(Interner& interner) : interner(interner) {}
+
+        void fold(Ast& ast);
+
+    private:
+        Interner& interner;
+        Ast* ast = nullptr;
+
+        // both return what should take the node's place, NO_NODE for nothing
+        NodeId foldStatement(NodeId stmt);
+        NodeId foldExpression(NodeId expr);
+
+        NodeId foldUnary(NodeId id);
+        NodeId foldBinary(NodeId id);
+
+        // the literal's value, or null if the node isn't one
+        const Value* constantOf(NodeId expr) const;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "interner.h"
+#include "interpreter/parallel.h"
+#include <cstring>
+#include <functional>
+
+namespace {
+
+// absorb() numbers new texts only once it has seen every piece. until then
+// their slots and map entries hold this bit, the shard, and where they are
+// in that shard's pending list
+constexpr Symbol PENDING = 0x80000000u;
+
+} // namespace
+
+Symbol Interner::intern(std::string_view text) {
+    uint64_t h = hash(text);
+    Shard& shard = shardOf(shards, h);
+    makeRoom(shard);
+
+    Slot& slot = find(shard, static_cast<uint32_t>(h), text, [&](Symbol s) { return texts[s]; });
+    if (slot.symbol != NO_SYMBOL) return slot.symbol;
+
+    Symbol symbol = static_cast<Symbol>(texts.size());
+    texts.push_back(store(text));
+    slot = {static_cast<uint32_t>(h), symbol};
+    shard.used++;
+    return symbol;
+}
+
+uint64_t Interner::hash(std::string_view text) {
+    return std::hash<std::string_view>{}(text);
+}
+
+void Interner::makeRoom(Shard& shard) {
+    if ((shard.used + 1) * 2 <= shard.slots.size()) return;
+
+    std::vector<Slot> old(std::max<size_t>(16, shard.slots.size() * 2));
+    old.swap(shard.slots);
+    size_t mask = shard.slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.symbol == NO_SYMBOL) continue;
+        size_t i = slot.hash & mask;
+        while (shard.slots[i].symbol != NO_SYMBOL) i = (i + 1) & mask;
+        shard.slots[i] = slot;
+    }
+}
+
+template <typename TextOf>
+Interner::Slot& Interner::find(Shard& shard, uint32_t h, std::string_view text, TextOf textOf) {
+    size_t mask = shard.slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        Slot& slot = shard.slots[i];
+        if (slot.symbol == NO_SYMBOL) return slot;
+        if (slot.hash == h && textOf(slot.symbol) == text) return slot;
+    }
+}
+
+// every text hashes to the same shard in a piece as here, so each shard can
+// be worked out on its own. a piece never holds the same text twice, so
+// which piece saw a text first is all that decides its number
+std::vector<std::vector<Symbol>> Interner::absorb(std::vector<Interner>& pieces, unsigned threads) {
+    size_t count = pieces.size();
+    std::vector<std::vector<Symbol>> maps(count);
+    for (size_t i = 0; i < count; i++) maps[i].assign(pieces[i].size(), NO_SYMBOL);
+
+    struct Pending {
+        uint32_t piece;
+        Symbol local;
+        Symbol symbol = NO_SYMBOL;  // once it has one
+    };
+    std::vector<Pending> pending[SHARDS];
+    auto pendingOf = [&](Symbol tagged) -> Pending& {
+        return pending[tagged & (SHARDS - 1)][(tagged & ~PENDING) >> SHARD_BITS];
+    };
+
+    // texts already here keep their symbols, new ones are pending on the
+    // first piece that has them and every later piece points at that
+    parallelFor(SHARDS, threads, [&](size_t s) {
+        Shard& shard = shards[s];
+        auto textOf = [&](Symbol symbol) {
+            if (!(symbol & PENDING)) return texts[symbol];
+            const Pending& p = pendingOf(symbol);
+            return pieces[p.piece].texts[p.local];
+        };
+        for (size_t i = 0; i < count; i++) {
+            for (const Slot& local : pieces[i].shards[s].slots) {
+                if (local.symbol == NO_SYMBOL) continue;
+                makeRoom(shard);
+                Slot& slot = find(shard, local.hash, pieces[i].texts[local.symbol], textOf);
+                if (slot.symbol == NO_SYMBOL) {
+                    Symbol tagged = PENDING | static_cast<Symbol>(pending[s].size() << SHARD_BITS) | static_cast<Symbol>(s);
+                    pending[s].push_back({static_cast<uint32_t>(i), local.symbol});
+                    slot = {local.hash, tagged};
+                    shard.used++;
+                }
+                maps[i][local.symbol] = slot.symbol;
+            }
+        }
+    });
+
+    // a piece's new texts are numbered in the order it saw them, after
+    // everything every earlier piece brought
+    auto isNew = [&](size_t i, Symbol local) {
+        Symbol m = maps[i][local];
+        return (m & PENDING) && pendingOf(m).piece == i;
+    };
+    std::vector<size_t> first(count + 1, texts.size());
+    parallelFor(count, threads, [&](size_t i) {
+        size_t added = 0;
+        for (Symbol l = 0; l < maps[i].size(); l++) added += isNew(i, l);
+        first[i + 1] = added;
+    });
+    for (size_t i = 0; i < count; i++) first[i + 1] += first[i];
+    texts.resize(first[count]);
+
+    parallelFor(count, threads, [&](size_t i) {
+        Symbol next = static_cast<Symbol>(first[i]);
+        for (Symbol l = 0; l < maps[i].size(); l++) {
+            if (!isNew(i, l)) continue;
+            texts[next] = pieces[i].texts[l];
+            pendingOf(maps[i][l]).symbol = next;
+            maps[i][l] = next++;
+        }
+    });
+    // everything still pending is a repeat, or a slot, of one numbered above
+    parallelFor(count, threads, [&](size_t i) {
+        for (Symbol& m : maps[i]) {
+            if (m & PENDING) m = pendingOf(m).symbol;
+        }
+    });
+    parallelFor(SHARDS, threads, [&](size_t s) {
+        for (Slot& slot : shards[s].slots) {
+            if (slot.symbol != NO_SYMBOL && (slot.symbol & PENDING)) slot.symbol = pendingOf(slot.symbol).symbol;
+        }
+    });
+
+    // the texts point into the pieces' blocks, so those are ours now
+    for (Interner& piece : pieces) {
+        for (auto& block : piece.blocks) large.push_back(std::move(block));
+        for (auto& block : piece.large) large.push_back(std::move(block));
+    }
+    return maps;
+}
+
+// copies text into the current block, or a block of its own if it's huge.
+// every text is preceded by its length so a bare pointer to it is enough
+// to get the whole string back (that's how Value stores interned strings)
+std::string_view Interner::store(std::string_view text) {
+    uint32_t length = static_cast<uint32_t>(text.size());
+    size_t needed = sizeof(length) + text.size();
+    char* at;
+
+    if (needed > BLOCK_SIZE / 4) {
+        large.push_back(std::make_unique<char[]>(needed));
+        at = large.back().get();
+    } else {
+        if (blockUsed + needed > BLOCK_SIZE) {
+            blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+            blockUsed = 0;
+        }
+        at = blocks.back().get() + blockUsed;
+        blockUsed += needed;
+    }
+
+    std::memcpy(at, &length, sizeof(length));
+    std::memcpy(at + sizeof(length), text.data(), text.size());
+    return std::string_view(at + sizeof(length), text.size());
+}
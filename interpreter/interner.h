@@ -0,0 +1,75 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using Symbol = uint32_t;
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+// hands out one small integer per distinct string. the lexer runs every
+// identifier and string literal through it, so later passes compare and
+// hash symbols instead of text. the text itself is packed into big blocks
+// that never move, views handed out stay valid as long as the interner,
+// and the 4 bytes in front of each view hold its length.
+//
+// one interner per program, everything compiled from a source shares it.
+//
+// the lookup table is split into shards by the top bits of the hash, each
+// an open addressed array of {hash, symbol}. one shard never looks at
+// another, which is what lets absorb() fill them on several threads.
+class Interner {
+    public:
+        Symbol intern(std::string_view text);
+
+        std::string_view text(Symbol symbol) const { return texts[symbol]; }
+        size_t size() const { return texts.size(); }
+
+        // for the parallel lexer: takes in the symbols of interners that each
+        // saw one piece of a source, numbered as if their texts had been
+        // interned here piece after piece, in order, so the ids come out the
+        // same as lexing the whole source with this one. hands back each
+        // piece's map from its symbols to these. the pieces' text is moved in
+        // rather than copied, leave them alone afterwards
+        std::vector<std::vector<Symbol>> absorb(std::vector<Interner>& pieces, unsigned threads);
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 64 * 1024;
+        static constexpr int SHARD_BITS = 6;
+        static constexpr size_t SHARDS = size_t(1) << SHARD_BITS;
+
+        // low 32 bits of the hash, enough to find the slot again when a
+        // shard grows, and to skip comparing text on nearly every mismatch
+        struct Slot {
+            uint32_t hash;
+            Symbol symbol = NO_SYMBOL;
+        };
+        // kept at most half full
+        struct Shard {
+            std::vector<Slot> slots;
+            size_t used = 0;
+        };
+
+        Shard shards[SHARDS];
+        std::vector<std::string_view> texts;
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t blockUsed = BLOCK_SIZE;
+        // strings too big to be worth packing get an allocation each, and
+        // absorbed interners' blocks end up here too
+        std::vector<std::unique_ptr<char[]>> large;
+
+        std::string_view store(std::string_view text);
+
+        static uint64_t hash(std::string_view text);
+        static Shard& shardOf(Shard* shards, uint64_t h) { return shards[h >> (64 - SHARD_BITS)]; }
+        static void makeRoom(Shard& shard);
+        // the slot holding text, or the empty one where it would go.
+        // textOf turns a slot's symbol back into its text
+        template <typename TextOf>
+        static Slot& find(Shard& shard, uint32_t h, std::string_view text, TextOf textOf);
+};
+
+#endif
@@ -1,59 +1,494 @@
 #include <stdio.h>
+#include <algorithm>
 #include <iostream>
-#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
-#include <sstream>
+#include <string>
 #include <vector>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "interpreter/lexer/lexer.h"
+#include "interpreter/lexer/parallel_lexer.h"
 #include "interpreter/token.h"
 #include "interpreter/parser/parser.h"
+#include "interpreter/resolver/resolver.h"
+#include "interpreter/checker/checker.h"
+#include "interpreter/folder/folder.h"
 #include "interpreter/evaluator/evaluator.h"
+#include "interpreter/compiler/compiler.h"
+#include "interpreter/vm/vm.h"
+#include "interpreter/source.h"
+#include "interpreter/profiler/profiler.h"
+#include "interpreter/profiler/sampler.h"
+#include "interpreter/profiler/trace.h"
+#include "interpreter/cache/cache.h"
+#include "interpreter/error.h"
+#include "interpreter/parallel.h"
+#include "interpreter/server/server.h"
+#include "interpreter/cppgen/cppgen.h"
 
 using std::string;
-using std::ifstream;
 
-string readFile(const string& path);
+int runBatch(const std::vector<string>& paths, unsigned jobs, bool treeWalk, bool useCache, bool useJit);
+
+struct PhaseTime {
+    const char* name;
+    double ms;
+};
+using Counters = std::vector<std::pair<const char*, size_t>>;
+void printStats(const std::vector<PhaseTime>& phases, const Counters& counters);
 std::string tokenTypeToString(TokenType type); // not necessary, but i'll leave it
 
-int main(int argc, char* argv[]){
-    if(argc != 2){
-        std::cerr << "Usage: zenith <filename>\n";
+// nothing below main prints script errors or exits on them, they all come
+// back up here as a ScriptError (error.h)
+int main(int argc, char* argv[]) try {
+    // --tree-walk runs the old ast walker instead of the vm, handy for
+    // diffing output and timing the two on the same file
+    bool treeWalk = false;
+    // --profile times every statement (on the tree walker) and prints a
+    // report to stderr at the end, --profile=file writes it there instead
+    bool profile = false;
+    std::string profilePath;
+    // --sample-profile=hz samples the running statements instead, cheap
+    // enough for tight loops. writes <prefix>.folded for flamegraph.pl and
+    // <prefix>.pb for pprof, prefix from --sample-out (zenith-profile)
+    int sampleHz = 0;
+    std::string sampleOut = "zenith-profile";
+    // --stats prints phase times and counters to stderr, --trace=file
+    // writes the phases and every top level statement as a chrome trace
+    bool stats = false;
+    std::string tracePath;
+    // --no-cache always compiles from scratch and leaves the cache alone
+    bool useCache = true;
+    // --no-jit interprets every loop, even hot ones (jit.h)
+    bool useJit = true;
+    // --lex-threads[=n] lexes the whole file up front on n threads (every
+    // core without a number), for huge generated scripts. -1 is off
+    int lexThreads = -1;
+    // --jobs[=n] runs several scripts at once, n at a time (every core
+    // without a number), and prints each one's output in the order given.
+    // more than one script, or @manifest, implies it. -1 is off
+    int jobs = -1;
+    // --serve=socket keeps running and takes scripts from --client=socket
+    // (server.h), with --jobs workers. --timeout=n stops any script that
+    // runs longer than n seconds, 0 is no limit
+    std::string servePath;
+    std::string clientPath;
+    int timeout = -1;
+    // --emit-cpp=file translates the script to c++ instead of running it
+    // (cppgen.h), --build then compiles that
+    std::string emitPath;
+    bool build = false;
+    std::vector<string> paths;
+    bool badArgs = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--tree-walk") {
+            treeWalk = true;
+        } else if (arg == "--profile" || arg.substr(0, 10) == "--profile=") {
+            profile = true;
+            treeWalk = true;
+            if (arg.size() > 10) profilePath = std::string(arg.substr(10));
+        } else if (arg.substr(0, 17) == "--sample-profile=") {
+            sampleHz = std::atoi(argv[i] + 17);
+            treeWalk = true;
+            if (sampleHz <= 0) {
+                badArgs = true;
+                break;
+            }
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg.substr(0, 8) == "--trace=" && arg.size() > 8) {
+            tracePath = std::string(arg.substr(8));
+        } else if (arg == "--lex-threads") {
+            lexThreads = 0;
+        } else if (arg.substr(0, 14) == "--lex-threads=") {
+            lexThreads = std::atoi(argv[i] + 14);
+            if (lexThreads <= 0) {
+                badArgs = true;
+                break;
+            }
+        } else if (arg.substr(0, 8) == "--serve=" && arg.size() > 8) {
+            servePath = std::string(arg.substr(8));
+        } else if (arg.substr(0, 9) == "--client=" && arg.size() > 9) {
+            clientPath = std::string(arg.substr(9));
+        } else if (arg.substr(0, 10) == "--timeout=") {
+            timeout = std::atoi(argv[i] + 10);
+            if (arg.size() == 10 || arg.find_first_not_of("0123456789", 10) != std::string_view::npos) {
+                badArgs = true;
+                break;
+            }
+        } else if (arg == "--jobs") {
+            jobs = 0;
+        } else if (arg.substr(0, 7) == "--jobs=") {
+            jobs = std::atoi(argv[i] + 7);
+            if (jobs <= 0) {
+                badArgs = true;
+                break;
+            }
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg.substr(0, 11) == "--emit-cpp=" && arg.size() > 11) {
+            emitPath = std::string(arg.substr(11));
+        } else if (arg == "--build") {
+            build = true;
+        } else if (arg == "--no-jit") {
+            useJit = false;
+        } else if (arg.substr(0, 13) == "--sample-out=" && arg.size() > 13) {
+            sampleOut = std::string(arg.substr(13));
+        } else if (arg == "-" || arg.substr(0, 2) != "--") {
+            paths.push_back(argv[i]);
+        } else {
+            badArgs = true;
+            break;
+        }
+    }
+
+    bool batch = jobs >= 0 || paths.size() > 1 || (paths.size() == 1 && paths[0][0] == '@');
+    // the profilers, --stats and --trace all report on one run, and the
+    // sampler's signal handler is one per process
+    bool instrumented = profile || sampleHz > 0 || stats || !tracePath.empty() || lexThreads >= 0;
+    if (batch && instrumented)
+        badArgs = true;
+    // the server only runs the vm, and takes its scripts from clients
+    if (!servePath.empty() && (instrumented || treeWalk || !clientPath.empty() || !paths.empty()))
+        badArgs = true;
+    if (timeout >= 0 && servePath.empty())
+        badArgs = true;
+    if (!clientPath.empty() && (instrumented || treeWalk || jobs >= 0 || paths.size() != 1))
+        badArgs = true;
+    if ((!emitPath.empty() && (instrumented || treeWalk || batch || !servePath.empty() || !clientPath.empty()))
+        || (build && emitPath.empty()))
+        badArgs = true;
+    if(badArgs || (paths.empty() && servePath.empty())){
+        std::cerr << "Usage: zenith [--tree-walk] [--no-cache] [--no-jit] [--lex-threads[=n]] [--stats] [--trace=file]\n"
+                     "              [--profile[=file]] [--sample-profile=hz [--sample-out=prefix]] <filename | ->\n"
+                     "       zenith --jobs[=n] [--tree-walk] [--no-cache] [--no-jit] <filename | @manifest>...\n"
+                     "       zenith --serve=socket [--jobs=n] [--timeout=seconds]\n"
+                     "       zenith --client=socket <filename | ->\n"
+                     "       zenith --emit-cpp=out.cpp [--build] <filename | ->\n";
         return 1;
     }
-    string sourceCode = readFile(argv[1]);
+    if (!servePath.empty())
+        return serve(servePath, jobs < 0 ? 0 : static_cast<unsigned>(jobs),
+                     timeout < 0 ? 0 : static_cast<unsigned>(timeout));
+    if (!clientPath.empty())
+        return runClient(clientPath, paths[0]);
+    if (batch)
+        return runBatch(paths, jobs < 0 ? 1 : static_cast<unsigned>(jobs), treeWalk, useCache, useJit);
+    const string& path = paths[0];
+    Tracer tracer;
+    Tracer* trace = tracePath.empty() ? nullptr : &tracer;
+    std::vector<PhaseTime> phases;
+    auto timed = [&](const char* name, auto&& work) {
+        auto start = Tracer::Clock::now();
+        work();
+        auto end = Tracer::Clock::now();
+        phases.push_back({name, std::chrono::duration<double, std::milli>(end - start).count()});
+        if (trace) trace->phase(name, start, end);
+    };
 
-    if (sourceCode.empty())
+    // mapped in place, every token's lexeme points into it
+    Source source;
+    timed("read", [&] { readFile(path, source); });
+    if (source.text().empty())
         return 1;
-        //readFile will print error
 
-    Lexer lexer(sourceCode);
-    std::vector<Token> tokens = lexer.scanTokens();
-    
-    Parser parser(tokens);
-    auto statements = parser.parse();
+    // what --stats says about the engine that ran
+    Counters counters;
+    auto vmCounters = [&](const ChunkView& chunk) {
+        // the vm has no scopes at run time, every local has a slot in one frame
+        counters.push_back({"bytecode bytes", chunk.codeSize});
+        counters.push_back({"frame slots", static_cast<size_t>(chunk.maxLocals)});
+        counters.push_back({"stack slots", static_cast<size_t>(chunk.maxStack)});
+    };
+
+    // a plain vm run goes through the compiled program cache (cache.h), and
+    // an unchanged script starts running straight from the mapped entry.
+    // --trace wants the ast for naming statements, so it always compiles
+    bool cacheable = useCache && !treeWalk && !trace && emitPath.empty();
+    ProgramCache cache(cacheable ? ProgramCache::defaultDir() : "", source.text());
+    bool hit = false;
+    if (!cache.path().empty()) timed("cache load", [&] { hit = cache.load(); });
+    if (hit) {
+        VM vm;
+        vm.setJit(useJit);
+        timed("run", [&] {
+            vm.run(cache.program());
+            standardOutput().flush();
+        });
+        if (stats) {
+            counters.push_back({"cache hit", 1});
+            counters.push_back({"heap strings", static_cast<size_t>(stringStats().buffers)});
+            counters.push_back({"heap string bytes", static_cast<size_t>(stringStats().bytes)});
+            vmCounters(cache.program());
+            printStats(phases, counters);
+        }
+        return 0;
+    }
+
+    // shared by every stage, string values in the program point into it
+    Interner interner;
+
+    // the parser pulls tokens from the lexer as it needs them. --stats and
+    // --trace time lexing on its own and --lex-threads needs the whole file
+    // at once, so those scan everything up front
+    bool upFront = stats || trace || lexThreads >= 0;
+    Lexer lexer(source.text(), interner);
+    std::vector<std::vector<Token>> scanned;
+    if (upFront) timed("lex", [&] {
+        if (lexThreads >= 0)
+            scanned = scanTokensParallel(source.text(), interner, lexThreads);
+        else
+            scanned.push_back(lexer.scanTokens());
+    });
+    TokenStream tokens = upFront ? TokenStream(scanned) : TokenStream(lexer);
 
-    Evaluator evaluator;
-    evaluator.run(statements);
+    Ast ast;
+    timed("parse", [&] { ast = Parser(tokens, interner).parse(); });
+
+    int globals = 0;
+    timed("resolve", [&] { globals = Resolver().resolve(ast); });
+    timed("check", [&] { Checker().check(ast, globals); });
+    timed("fold", [&] { Folder(interner).fold(ast); });
+
+    if (!emitPath.empty()) {
+        writeCpp(emitPath, CppGen().generate(ast, path));
+        return build ? buildCpp(emitPath) : 0;
+    }
+
+    if (profile) {
+        Profiler profiler(ast, source.text());
+        Evaluator evaluator;
+        evaluator.setProfiler(&profiler);
+        evaluator.run(ast, globals);
+        standardOutput().flush();
+
+        if (profilePath.empty()) {
+            profiler.report(std::cerr);
+            return 0;
+        }
+        std::ofstream report(profilePath);
+        if (!report) {
+            std::cerr << "[ERROR] Could not write profile to '" << profilePath << "'\n";
+            return 1;
+        }
+        profiler.report(report);
+        return 0;
+    }
+
+    if (sampleHz > 0) {
+        Sampler sampler(ast, source.text(), path);
+        Evaluator evaluator;
+        evaluator.setSampler(&sampler);
+        if (!sampler.start(sampleHz))
+            return 1;
+        evaluator.run(ast, globals);
+        sampler.stop();
+        standardOutput().flush();
+
+        std::ofstream folded(sampleOut + ".folded");
+        std::ofstream pprof(sampleOut + ".pb", std::ios::binary);
+        if (!folded || !pprof) {
+            std::cerr << "[ERROR] Could not write profile to '" << sampleOut << ".*'\n";
+            return 1;
+        }
+        sampler.writeFolded(folded);
+        sampler.writePprof(pprof);
+        std::cerr << "[profile] " << sampler.sampleCount() << " samples at " << sampleHz
+                  << " hz written to " << sampleOut << ".folded and " << sampleOut << ".pb";
+        if (sampler.droppedCount())
+            std::cerr << " (" << sampler.droppedCount() << " dropped, buffer full)";
+        std::cerr << "\n";
+        return 0;
+    }
 
+    if (treeWalk) {
+        Evaluator evaluator;
+        evaluator.setTracer(trace);
+        timed("run", [&] {
+            evaluator.run(ast, globals);
+            standardOutput().flush();
+        });
+        counters.push_back({"scopes entered", evaluator.environment().scopesEntered});
+        counters.push_back({"peak scope depth", evaluator.environment().peakDepth});
+    } else {
+        Chunk chunk;
+        timed("compile", [&] {
+            Compiler compiler;
+            compiler.setMarkStatements(trace != nullptr);
+            chunk = compiler.compile(ast, globals);
+        });
+        // stored before running, a runtime error doesn't make the program any less valid
+        if (!cache.path().empty()) timed("cache store", [&] { cache.store(chunk); });
+        VM vm;
+        vm.setJit(useJit);
+        vm.setTracer(trace);
+        timed("run", [&] {
+            vm.run(chunk);
+            standardOutput().flush();
+        });
+        vmCounters(chunk.view());
+    }
+
+    if (trace) {
+        tracer.endMarks();
+        if (!tracer.write(tracePath, ast, source.text())) {
+            std::cerr << "[ERROR] Could not write trace to '" << tracePath << "'\n";
+            return 1;
+        }
+    }
+
+    if (stats) {
+        size_t tokenCount = 0;
+        for (const auto& piece : scanned) tokenCount += piece.size();
+        counters.insert(counters.begin(), {
+            {"tokens", tokenCount},
+            {"ast nodes", ast.nodeCount()},
+            {"heap strings", static_cast<size_t>(stringStats().buffers)},
+            {"heap string bytes", static_cast<size_t>(stringStats().bytes)},
+        });
+        printStats(phases, counters);
+    }
+    return 0;
+} catch (const ScriptError& e) {
+    // the script's own output goes first, then what stopped it
+    standardOutput().flush();
+    std::cerr << e.what();
+    return 1;
+}
+
+void printStats(const std::vector<PhaseTime>& phases, const Counters& counters) {
+    char row[96];
+    double total = 0;
+    std::cerr << "== stats ==\n";
+    for (const PhaseTime& p : phases) {
+        std::snprintf(row, sizeof(row), "%-18s %12.3f ms\n", p.name, p.ms);
+        std::cerr << row;
+        total += p.ms;
+    }
+    std::snprintf(row, sizeof(row), "%-18s %12.3f ms\n", "total", total);
+    std::cerr << row;
+
+    for (const auto& [name, value] : counters) {
+        std::snprintf(row, sizeof(row), "%-18s %12zu\n", name, value);
+        std::cerr << row;
+    }
 }
 
-string readFile(const string& path){
-    
-    if (path.length() <= 4 || path.substr(path.length() - 4) != ".zen") {
-        std::cerr << "[ERROR] File must have a .zen extension: '" << path << "'\n";
-        return "";
+// one script of a --jobs run: what it printed, what it reported, how it went
+struct ScriptResult {
+    string out;
+    string err;
+    bool ok = false;
+    bool done = false;
+};
+
+// the same pipeline as a plain run, minus the instrumentation, with output
+// collected instead of printed. everything lives on this thread's stack,
+// scripts running side by side share nothing but the cache directory
+void runScript(const string& path, bool treeWalk, bool useCache, bool useJit, ScriptResult& result) {
+    Output out(result.out);
+    try {
+        Source source;
+        readFile(path, source);
+        if (source.text().empty()) return;
+
+        ProgramCache cache(useCache && !treeWalk ? ProgramCache::defaultDir() : "", source.text());
+        if (!cache.path().empty() && cache.load()) {
+            VM vm(out);
+            vm.setJit(useJit);
+            vm.run(cache.program());
+        } else {
+            Interner interner;
+            Lexer lexer(source.text(), interner);
+            TokenStream tokens(lexer);
+            Ast ast = Parser(tokens, interner).parse();
+            int globals = Resolver().resolve(ast);
+            Checker().check(ast, globals);
+            Folder(interner).fold(ast);
+            if (treeWalk) {
+                Evaluator(out).run(ast, globals);
+            } else {
+                Chunk chunk = Compiler().compile(ast, globals);
+                if (!cache.path().empty()) cache.store(chunk);
+                VM vm(out);
+                vm.setJit(useJit);
+                vm.run(chunk);
+            }
+        }
+        out.flush();
+        result.ok = true;
+    } catch (const ScriptError& e) {
+        out.flush();
+        result.err = e.what();
     }
-    ifstream inputFile(path);
+}
 
-    if(!inputFile.is_open()){
-        std::cerr << "[ERROR] Could not open file '" << path << "'\n";
-        return "";
+// @manifest: one script path per line, blank lines and # comments skipped
+bool readManifest(const string& path, std::vector<string>& scripts) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "[ERROR] Could not open manifest '" << path << "'\n";
+        return false;
+    }
+    for (string line; std::getline(in, line);) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        scripts.push_back(line.substr(start, end - start + 1));
     }
+    return true;
+}
+
+int runBatch(const std::vector<string>& paths, unsigned jobs, bool treeWalk, bool useCache, bool useJit) {
+    std::vector<string> scripts;
+    for (const string& p : paths) {
+        if (p[0] != '@') scripts.push_back(p);
+        else if (!readManifest(p.substr(1), scripts)) return 1;
+    }
+    if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
 
-    std::stringstream buffer;
-    buffer << inputFile.rdbuf();
+    // workers finish in any order, this thread prints in the given one:
+    // script i goes out as soon as it and everything before it is done
+    std::vector<ScriptResult> results(scripts.size());
+    std::mutex lock;
+    std::condition_variable finished;
+    std::thread pool([&] {
+        parallelFor(scripts.size(), jobs, [&](size_t i) {
+            ScriptResult result;
+            runScript(scripts[i], treeWalk, useCache, useJit, result);
+            std::lock_guard<std::mutex> guard(lock);
+            results[i] = std::move(result);
+            results[i].done = true;
+            finished.notify_one();
+        });
+    });
 
-    return buffer.str();
+    int status = 0;
+    Output& stdOut = standardOutput();
+    for (size_t i = 0; i < results.size(); i++) {
+        ScriptResult& result = results[i];
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [&] { return result.done; });
+        }
+        stdOut.write(result.out);
+        stdOut.flush();
+        // every line of the report says which script it's about
+        for (size_t at = 0, next; at < result.err.size(); at = next) {
+            next = std::min(result.err.find('\n', at), result.err.size() - 1) + 1;
+            std::cerr << scripts[i] << ": " << std::string_view(result.err).substr(at, next - at);
+        }
+        if (!result.ok) status = 1;
+        result = ScriptResult();
+    }
+    pool.join();
+    return status;
 }
 
 std::string tokenTypeToString(TokenType type) {
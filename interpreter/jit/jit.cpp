@@ -0,0 +1,633 @@
+#include "jit.h"
+
+#ifdef ZENITH_JIT
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+enum Reg : int {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+// the low nibble of jcc and setcc
+enum class Cond : uint8_t {
+    Equal = 0x4, NotEqual = 0x5,
+    Less = 0xC, GreaterEqual = 0xD, LessEqual = 0xE, Greater = 0xF,
+};
+
+// the native code gets the frame in rdi and returns in eax. rax and rdx are
+// left free for idiv, rsp is the stack
+constexpr Reg FRAME = RDI;
+// the operand stack, a register per depth
+constexpr Reg STACK_REGS[] = {RCX, R8, R9, R10, R11};
+constexpr int STACK_DEPTH = sizeof(STACK_REGS) / sizeof(STACK_REGS[0]);
+// for the most used locals. all but rsi are callee saved and get pushed
+constexpr Reg LOCAL_REGS[] = {RBX, RBP, RSI, R12, R13, R14, R15};
+constexpr int LOCAL_COUNT = sizeof(LOCAL_REGS) / sizeof(LOCAL_REGS[0]);
+constexpr Reg SAVED_REGS[] = {RBX, RBP, R12, R13, R14, R15};
+
+// just enough x86-64 for these loops: 32 bit integer ops between
+// registers, loads and stores relative to the frame, and jumps
+class Assembler {
+    public:
+        std::vector<uint8_t> code;
+
+        size_t here() const { return code.size(); }
+
+        void mov(int dst, int src) { if (dst != src) regReg(0x89, dst, src); }
+        void add(int dst, int src) { regReg(0x01, dst, src); }
+        void sub(int dst, int src) { regReg(0x29, dst, src); }
+        void cmp(int a, int b)     { regReg(0x39, a, b); }
+        void addImm(int dst, uint32_t imm) { regImm(0, dst, imm); }
+        void cmpImm(int a, uint32_t imm)   { regImm(7, a, imm); }
+        void test(int a)           { regReg(0x85, a, a); }
+        void imul(int dst, int src) {
+            rex(dst, src);
+            emit(0x0F, 0xAF);
+            modrm(3, dst, src);
+        }
+        void movImm(int dst, uint32_t imm) {
+            rex(0, dst);
+            emit(0xB8 + (dst & 7));
+            dword(imm);
+        }
+        void xorImm(int dst, uint8_t imm) {
+            rex(0, dst);
+            emit(0x83);
+            modrm(3, 6, dst);
+            emit(imm);
+        }
+        void neg(int dst) {
+            rex(0, dst);
+            emit(0xF7);
+            modrm(3, 3, dst);
+        }
+        // eax = edx:eax / src, sign extended from eax first
+        void divide(int src) {
+            emit(0x99); // cdq
+            rex(0, src);
+            emit(0xF7);
+            modrm(3, 7, src);
+        }
+        // dst = cond ? 1 : 0, from the flags
+        void set(Cond cond, int dst) {
+            rex(0, dst, true);
+            emit(0x0F, 0x90 | static_cast<uint8_t>(cond));
+            modrm(3, 0, dst);
+            rex(dst, dst, true);
+            emit(0x0F, 0xB6); // movzx dst, dst8
+            modrm(3, dst, dst);
+        }
+
+        // the payload or tag of a frame slot: [rdi + offset]
+        void load(int dst, int32_t offset) {
+            rex(dst, FRAME);
+            emit(0x8B);
+            frame(dst, offset);
+        }
+        void loadByte(int dst, int32_t offset) {
+            rex(dst, FRAME);
+            emit(0x0F, 0xB6);
+            frame(dst, offset);
+        }
+        void store(int32_t offset, int src) {
+            rex(src, FRAME);
+            emit(0x89);
+            frame(src, offset);
+        }
+        void storeByte(int32_t offset, uint8_t imm) {
+            emit(0xC6);
+            frame(0, offset);
+            emit(imm);
+        }
+
+        // dst = the address, as a 64 bit immediate
+        void movAddress(int dst, const void* address) {
+            emit(static_cast<uint8_t>(0x48 | ((dst & 8) ? 1 : 0)));
+            emit(0xB8 + (dst & 7));
+            uint64_t v = reinterpret_cast<uintptr_t>(address);
+            dword(static_cast<uint32_t>(v));
+            dword(static_cast<uint32_t>(v >> 32));
+        }
+        // cmp byte [rax], 0, how the interrupt flag gets read
+        void cmpByteAtRax() { emit(0x80, 0x38); emit(0); }
+
+        void push(int r) { if (r & 8) emit(0x41); emit(0x50 + (r & 7)); }
+        void pop(int r)  { if (r & 8) emit(0x41); emit(0x58 + (r & 7)); }
+        void ret()       { emit(0xC3); }
+
+        // jumps are rel32, these return where it goes so it can be patched
+        size_t jump() {
+            emit(0xE9);
+            return hole();
+        }
+        size_t jumpIf(Cond cond) {
+            emit(0x0F, 0x80 | static_cast<uint8_t>(cond));
+            return hole();
+        }
+        void patch(size_t at, size_t target) {
+            int32_t rel = static_cast<int32_t>(target) - static_cast<int32_t>(at + 4);
+            std::memcpy(&code[at], &rel, 4);
+        }
+
+    private:
+        void emit(uint8_t b) { code.push_back(b); }
+        void emit(uint8_t a, uint8_t b) { emit(a); emit(b); }
+        void dword(uint32_t v) {
+            for (int i = 0; i < 4; i++) emit(static_cast<uint8_t>(v >> (8 * i)));
+        }
+        size_t hole() {
+            dword(0);
+            return here() - 4;
+        }
+        // force for byte registers, so sil and dil aren't read as dh and bh
+        void rex(int reg, int rm, bool force = false) {
+            uint8_t prefix = 0x40 | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+            if (prefix != 0x40 || force) emit(prefix);
+        }
+        void modrm(int mod, int reg, int rm) {
+            emit(static_cast<uint8_t>(mod << 6 | (reg & 7) << 3 | (rm & 7)));
+        }
+        void regReg(uint8_t op, int dst, int src) {
+            rex(src, dst);
+            emit(op);
+            modrm(3, src, dst);
+        }
+        void regImm(int ext, int dst, uint32_t imm) {
+            rex(0, dst);
+            emit(0x81);
+            modrm(3, ext, dst);
+            dword(imm);
+        }
+        void frame(int reg, int32_t offset) {
+            modrm(2, reg, FRAME);
+            dword(static_cast<uint32_t>(offset));
+        }
+};
+
+enum class Type : uint8_t { Unknown, Int, Bool };
+
+// what the loop does with one frame slot
+struct Local {
+    Type type = Type::Unknown;
+    bool touched = false;
+    bool definedFirst = false;  // its first use declares it, the old value is dead
+    bool written = false;
+    uint32_t uses = 0;
+    int reg = -1;               // or -1, then it stays in the frame
+};
+
+int32_t tagOffset(uint32_t slot)     { return static_cast<int32_t>(slot * sizeof(Value)); }
+int32_t payloadOffset(uint32_t slot) { return static_cast<int32_t>(slot * sizeof(Value) + 8); }
+
+Cond compareCond(uint8_t op) {
+    switch (op) {
+        case OP_GREATER: case OP_GREATER_INT:             return Cond::Greater;
+        case OP_GREATER_EQUAL: case OP_GREATER_EQUAL_INT: return Cond::GreaterEqual;
+        case OP_LESS: case OP_LESS_INT:                   return Cond::Less;
+        case OP_LESS_EQUAL: case OP_LESS_EQUAL_INT:       return Cond::LessEqual;
+        case OP_EQUAL:         return Cond::Equal;
+        default:               return Cond::NotEqual;
+    }
+}
+
+// jcc and setcc conditions come in pairs, the low bit flips them
+Cond inverse(Cond cond) { return static_cast<Cond>(static_cast<uint8_t>(cond) ^ 1); }
+bool isOrdering(uint8_t cmp) { return cmp != OP_EQUAL && cmp != OP_NOT_EQUAL; }
+
+static_assert(sizeof(std::atomic<bool>) == 1, "the native code reads the interrupt flag as a byte");
+
+} // namespace
+
+Jit::~Jit() {
+    for (auto& loop : loops) {
+        if (loop && loop->code) munmap(loop->code, loop->size);
+    }
+}
+
+Jit::Exit Jit::run(const ChunkView& chunk, uint32_t loop, uint32_t header, uint32_t end,
+                   Value* locals, uint32_t& fault) {
+    if (loop >= loops.size()) loops.resize(loop + 1);
+    if (!loops[loop]) {
+        loops[loop] = compile(chunk, header, end, locals);
+        if (!loops[loop]) {
+            counts[loop] = THRESHOLD + 1; // never again
+            return Exit::Interpret;
+        }
+    }
+
+    const Loop& native = *loops[loop];
+    for (const Guard& g : native.guards) {
+        unsigned char tag = locals[g.slot].bytes[0];
+        if (g.exact ? tag != g.tag : tag == g.tag) return Exit::Interpret;
+    }
+    uint32_t result = reinterpret_cast<uint32_t (*)(Value*)>(native.code)(locals);
+    if (result == 0) return Exit::Finished;
+    if (result == 1) return Exit::Interrupted;
+    fault = result - 2;
+    return Exit::DivideByZero;
+}
+
+std::unique_ptr<Jit::Loop> Jit::compile(const ChunkView& chunk, uint32_t header, uint32_t end,
+                                        const Value* locals) {
+    const uint8_t* code = chunk.code;
+    size_t length = end - header;
+    std::vector<Local> slots(chunk.maxLocals);
+
+    auto entryType = [&](uint32_t slot) {
+        if (locals[slot].bytes[0] == Value::INT) return Type::Int;
+        if (locals[slot].bytes[0] == Value::BOOL) return Type::Bool;
+        return Type::Unknown;
+    };
+    // false if the slot can't be used that way
+    enum Use { READ, WRITE, DEFINE };
+    auto touch = [&](uint32_t slot, Use use, Type type) {
+        if (slot >= slots.size()) return false;
+        Local& local = slots[slot];
+        if (!local.touched) {
+            local.touched = true;
+            local.definedFirst = use == DEFINE;
+            local.type = use == DEFINE ? type : entryType(slot);
+        }
+        local.uses++;
+        local.written |= use != READ;
+        if (local.type == Type::Unknown) return false;
+        return use == READ || local.type == type;
+    };
+
+    // first pass: check everything in the loop is something we can do,
+    // with types known, and note the stack depth at every instruction
+    std::vector<int> depthAt(length, -1);
+    // stack types at jump targets ahead of us
+    std::vector<std::vector<Type>> pending(length + 1);
+    std::vector<bool> hasPending(length + 1, false);
+    std::vector<Type> stack;
+    bool reachable = true;
+    auto jumpTo = [&](uint32_t target, const std::vector<Type>& state) {
+        if (target <= header || target > end) return false;
+        size_t at = target - header;
+        if (hasPending[at]) return pending[at] == state;
+        if (target == end && !state.empty()) return false;
+        pending[at] = state;
+        hasPending[at] = true;
+        return true;
+    };
+    auto popType = [&](Type want) {
+        if (stack.empty() || stack.back() != want) return false;
+        stack.pop_back();
+        return true;
+    };
+
+    for (size_t o = header; o < end;) {
+        size_t at = o - header;
+        if (hasPending[at]) {
+            if (reachable && pending[at] != stack) return nullptr;
+            stack = pending[at];
+            reachable = true;
+        }
+        if (!reachable) return nullptr;
+        depthAt[at] = static_cast<int>(stack.size());
+
+        uint8_t op = code[o];
+        if (o + instructionSize(op) > end) return nullptr;
+        uint32_t operand = instructionSize(op) >= 5 ? readOperand(code + o + 1) : 0;
+        switch (op) {
+            case OP_CONSTANT: {
+                if (operand >= chunk.constantCount) return nullptr;
+                const Value& c = chunk.constants[operand];
+                if (c.isInt()) stack.push_back(Type::Int);
+                else if (c.isBool()) stack.push_back(Type::Bool);
+                else return nullptr;
+                break;
+            }
+            case OP_TRUE:
+            case OP_FALSE:
+                stack.push_back(Type::Bool);
+                break;
+            case OP_POP:
+                if (stack.empty()) return nullptr;
+                stack.pop_back();
+                break;
+
+            case OP_DEFINE_LOCAL: {
+                TokenType declared = static_cast<TokenType>(code[o + 5]);
+                Type want = declared == TYPE_INT ? Type::Int : declared == TYPE_BOOL ? Type::Bool : Type::Unknown;
+                if (want == Type::Unknown || !popType(want) || !touch(operand, DEFINE, want)) return nullptr;
+                break;
+            }
+            case OP_STORE_LOCAL: {
+                if (stack.empty()) return nullptr;
+                Type type = stack.back();
+                stack.pop_back();
+                if (!touch(operand, DEFINE, type)) return nullptr;
+                break;
+            }
+            case OP_GET_LOCAL:
+                if (!touch(operand, READ, Type::Unknown)) return nullptr;
+                stack.push_back(slots[operand].type);
+                break;
+            case OP_SET_LOCAL:
+                if (stack.empty() || !touch(operand, WRITE, stack.back())) return nullptr;
+                break;
+
+            case OP_ADD: case OP_SUBTRACT: case OP_MULTIPLY: case OP_DIVIDE:
+            case OP_ADD_INT: case OP_SUBTRACT_INT: case OP_MULTIPLY_INT: case OP_DIVIDE_INT:
+                if (!popType(Type::Int) || !popType(Type::Int)) return nullptr;
+                stack.push_back(Type::Int);
+                break;
+            case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL:
+            case OP_GREATER_INT: case OP_GREATER_EQUAL_INT: case OP_LESS_INT: case OP_LESS_EQUAL_INT:
+                if (!popType(Type::Int) || !popType(Type::Int)) return nullptr;
+                stack.push_back(Type::Bool);
+                break;
+            case OP_EQUAL:
+            case OP_NOT_EQUAL: {
+                // an int never equals a bool, but that's not worth compiling
+                if (stack.size() < 2 || stack[stack.size() - 1] != stack[stack.size() - 2]) return nullptr;
+                stack.pop_back();
+                stack.back() = Type::Bool;
+                break;
+            }
+            case OP_NEGATE:
+            case OP_NEGATE_INT:
+                if (stack.empty() || stack.back() != Type::Int) return nullptr;
+                break;
+            case OP_NOT:
+                if (stack.empty() || stack.back() != Type::Bool) return nullptr;
+                break;
+
+            case OP_JUMP:
+                if (!jumpTo(operand, stack)) return nullptr;
+                reachable = false;
+                break;
+            case OP_JUMP_IF_FALSE:
+                if (!popType(Type::Bool) || !jumpTo(operand, stack)) return nullptr;
+                break;
+            case OP_JUMP_IF_FALSE_OR_POP:
+            case OP_JUMP_IF_TRUE_OR_POP:
+                if (stack.empty() || stack.back() != Type::Bool || !jumpTo(operand, stack)) return nullptr;
+                stack.pop_back();
+                break;
+            // the superinstructions, the same checks as the ops they stand for
+            case OP_ADD_LOCAL_CONST: {
+                uint32_t c = readOperand(code + o + 5);
+                if (c >= chunk.constantCount || !chunk.constants[c].isInt()
+                    || !touch(operand, WRITE, Type::Int)) return nullptr;
+                break;
+            }
+            case OP_COMPARE_JUMP: {
+                uint8_t cmp = code[o + 1];
+                if (stack.size() < 2 || stack[stack.size() - 1] != stack[stack.size() - 2]) return nullptr;
+                if (isOrdering(cmp) && stack.back() != Type::Int) return nullptr;
+                stack.resize(stack.size() - 2);
+                if (!jumpTo(readOperand(code + o + 2), stack)) return nullptr;
+                break;
+            }
+            case OP_LOCAL_CONST_COMPARE_JUMP:
+            case OP_LOCALS_COMPARE_JUMP: {
+                uint32_t left = readOperand(code + o + 2);
+                uint32_t right = readOperand(code + o + 6);
+                if (!touch(left, READ, Type::Unknown)) return nullptr;
+                Type type;
+                if (op == OP_LOCALS_COMPARE_JUMP) {
+                    if (!touch(right, READ, Type::Unknown)) return nullptr;
+                    type = slots[right].type;
+                } else {
+                    if (right >= chunk.constantCount || !chunk.constants[right].isInt()) return nullptr;
+                    type = Type::Int;
+                }
+                if (slots[left].type != type || (isOrdering(code[o + 1]) && type != Type::Int)) return nullptr;
+                if (!jumpTo(readOperand(code + o + 10), stack)) return nullptr;
+                break;
+            }
+
+            case OP_LOOP:
+                // this loop's own back edge, or a loop inside it
+                if (!stack.empty() || operand < header || operand >= o || depthAt[operand - header] != 0)
+                    return nullptr;
+                reachable = false;
+                break;
+
+            default:
+                return nullptr; // display, trace marks, anything with strings
+        }
+        if (static_cast<int>(stack.size()) > STACK_DEPTH) return nullptr;
+        o += instructionSize(op);
+    }
+    if (reachable || code[end - instructionSize(OP_LOOP)] != OP_LOOP) return nullptr;
+
+    // registers for the locals used the most, the rest stay in the frame
+    std::vector<uint32_t> used;
+    for (uint32_t slot = 0; slot < slots.size(); slot++) {
+        if (slots[slot].touched) used.push_back(slot);
+    }
+    std::stable_sort(used.begin(), used.end(),
+                     [&](uint32_t a, uint32_t b) { return slots[a].uses > slots[b].uses; });
+    for (size_t i = 0; i < used.size() && i < LOCAL_COUNT; i++) slots[used[i]].reg = LOCAL_REGS[i];
+
+    auto loop = std::make_unique<Loop>();
+    for (uint32_t slot : used) {
+        const Local& local = slots[slot];
+        // a local the loop declares gets written over without releasing
+        // what was there, fine for anything but a heap string
+        if (local.definedFirst) loop->guards.push_back({slot, Value::STR_HEAP, false});
+        else loop->guards.push_back({slot, local.type == Type::Int ? Value::INT : Value::BOOL, true});
+    }
+
+    // second pass: the code
+    Assembler a;
+    for (Reg r : SAVED_REGS) a.push(r);
+    for (uint32_t slot : used) {
+        const Local& local = slots[slot];
+        if (local.reg < 0) continue;
+        if (local.definedFirst) a.movImm(local.reg, 0);
+        else if (local.type == Type::Int) a.load(local.reg, payloadOffset(slot));
+        else a.loadByte(local.reg, payloadOffset(slot));
+    }
+
+    std::vector<size_t> nativeAt(length + 1, 0);
+    std::vector<std::pair<size_t, uint32_t>> jumps;     // hole, bytecode target
+    std::vector<std::pair<size_t, uint32_t>> divisions; // hole, offset of the division
+    std::vector<size_t> interrupts;                     // holes
+    auto jumpLater = [&](size_t hole, uint32_t target) { jumps.push_back({hole, target}); };
+    auto getLocal = [&](int dst, uint32_t slot) {
+        const Local& local = slots[slot];
+        if (local.reg >= 0) a.mov(dst, local.reg);
+        else if (local.type == Type::Int) a.load(dst, payloadOffset(slot));
+        else a.loadByte(dst, payloadOffset(slot));
+    };
+    auto setLocal = [&](uint32_t slot, int src) {
+        const Local& local = slots[slot];
+        if (local.reg >= 0) a.mov(local.reg, src);
+        else a.store(payloadOffset(slot), src);
+    };
+
+    for (size_t o = header; o < end;) {
+        nativeAt[o - header] = a.here();
+        int depth = depthAt[o - header];
+        int top = depth > 0 ? STACK_REGS[depth - 1] : -1;
+        int next = depth < STACK_DEPTH ? STACK_REGS[depth] : -1;
+        int second = depth > 1 ? STACK_REGS[depth - 2] : -1;
+        uint8_t op = code[o];
+        uint32_t operand = instructionSize(op) >= 5 ? readOperand(code + o + 1) : 0;
+        switch (op) {
+            case OP_CONSTANT: {
+                const Value& c = chunk.constants[operand];
+                a.movImm(next, c.isInt() ? static_cast<uint32_t>(c.asInt()) : c.asBool());
+                break;
+            }
+            case OP_TRUE:  a.movImm(next, 1); break;
+            case OP_FALSE: a.movImm(next, 0); break;
+            case OP_POP:   break;
+
+            case OP_DEFINE_LOCAL:
+            case OP_STORE_LOCAL:
+            case OP_SET_LOCAL:    setLocal(operand, top); break;
+            case OP_GET_LOCAL:    getLocal(next, operand); break;
+
+            case OP_ADD:      case OP_ADD_INT:      a.add(second, top); break;
+            case OP_SUBTRACT: case OP_SUBTRACT_INT: a.sub(second, top); break;
+            case OP_MULTIPLY: case OP_MULTIPLY_INT: a.imul(second, top); break;
+            case OP_DIVIDE:   case OP_DIVIDE_INT: {
+                a.test(top);
+                divisions.push_back({a.jumpIf(Cond::Equal), static_cast<uint32_t>(o)});
+                // idiv faults on INT_MIN / -1, and x / -1 is -x anyway, wrapped
+                // like divideInt's
+                a.cmpImm(top, UINT32_MAX);
+                size_t divide = a.jumpIf(Cond::NotEqual);
+                a.neg(second);
+                size_t done = a.jump();
+                a.patch(divide, a.here());
+                a.mov(RAX, second);
+                a.divide(top);
+                a.mov(second, RAX);
+                a.patch(done, a.here());
+                break;
+            }
+
+            case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL:
+            case OP_GREATER_INT: case OP_GREATER_EQUAL_INT: case OP_LESS_INT: case OP_LESS_EQUAL_INT:
+            case OP_EQUAL: case OP_NOT_EQUAL:
+                a.cmp(second, top);
+                a.set(compareCond(op), second);
+                break;
+            case OP_NEGATE: case OP_NEGATE_INT: a.neg(top); break;
+            case OP_NOT:    a.xorImm(top, 1); break;
+
+            case OP_JUMP:
+                jumpLater(a.jump(), operand);
+                break;
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_FALSE_OR_POP:
+                a.test(top);
+                jumpLater(a.jumpIf(Cond::Equal), operand);
+                break;
+            case OP_JUMP_IF_TRUE_OR_POP:
+                a.test(top);
+                jumpLater(a.jumpIf(Cond::NotEqual), operand);
+                break;
+
+            case OP_ADD_LOCAL_CONST: {
+                uint32_t c = static_cast<uint32_t>(chunk.constants[readOperand(code + o + 5)].asInt());
+                const Local& local = slots[operand];
+                if (local.reg >= 0) {
+                    a.addImm(local.reg, c);
+                } else {
+                    a.load(RAX, payloadOffset(operand));
+                    a.addImm(RAX, c);
+                    a.store(payloadOffset(operand), RAX);
+                }
+                break;
+            }
+            case OP_COMPARE_JUMP:
+                a.cmp(second, top);
+                jumpLater(a.jumpIf(inverse(compareCond(code[o + 1]))), readOperand(code + o + 2));
+                break;
+            case OP_LOCAL_CONST_COMPARE_JUMP:
+            case OP_LOCALS_COMPARE_JUMP: {
+                uint32_t left = readOperand(code + o + 2);
+                uint32_t right = readOperand(code + o + 6);
+                // locals left in the frame are compared from rax and rdx
+                int l = slots[left].reg;
+                if (l < 0) getLocal(l = RAX, left);
+                if (op == OP_LOCAL_CONST_COMPARE_JUMP) {
+                    a.cmpImm(l, static_cast<uint32_t>(chunk.constants[right].asInt()));
+                } else {
+                    int r = slots[right].reg;
+                    if (r < 0) getLocal(r = RDX, right);
+                    a.cmp(l, r);
+                }
+                jumpLater(a.jumpIf(inverse(compareCond(code[o + 1]))), readOperand(code + o + 10));
+                break;
+            }
+
+            case OP_LOOP:
+                // nothing's on the stack at a back edge, rax is free
+                if (interrupt) {
+                    a.movAddress(RAX, interrupt);
+                    a.cmpByteAtRax();
+                    interrupts.push_back(a.jumpIf(Cond::NotEqual));
+                }
+                a.patch(a.jump(), nativeAt[operand - header]);
+                break;
+        }
+        o += instructionSize(op);
+    }
+
+    // leaving: eax is 0, 1 if interrupted, or the offset of a division by
+    // zero plus two.
+    // the locals written go back to the frame either way
+    nativeAt[length] = a.here();
+    a.movImm(RAX, 0);
+    size_t leave = a.here();
+    for (uint32_t slot : used) {
+        const Local& local = slots[slot];
+        if (!local.written) continue;
+        a.storeByte(tagOffset(slot), local.type == Type::Int ? Value::INT : Value::BOOL);
+        if (local.reg >= 0) a.store(payloadOffset(slot), local.reg);
+    }
+    for (int i = sizeof(SAVED_REGS) / sizeof(SAVED_REGS[0]) - 1; i >= 0; i--) a.pop(SAVED_REGS[i]);
+    a.ret();
+
+    for (auto [hole, offset] : divisions) {
+        a.patch(hole, a.here());
+        a.movImm(RAX, offset + 2);
+        a.patch(a.jump(), leave);
+    }
+    for (size_t hole : interrupts) {
+        a.patch(hole, a.here());
+        a.movImm(RAX, 1);
+        a.patch(a.jump(), leave);
+    }
+    for (auto [hole, target] : jumps) a.patch(hole, nativeAt[target - header]);
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    loop->size = (a.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, loop->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, a.code.data(), a.code.size());
+    if (mprotect(memory, loop->size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, loop->size);
+        return nullptr;
+    }
+    loop->code = memory;
+    return loop;
+}
+
+#else
+
+Jit::~Jit() {}
+
+Jit::Exit Jit::run(const ChunkView&, uint32_t, uint32_t, uint32_t, Value*, uint32_t&) {
+    return Exit::Interpret;
+}
+
+std::unique_ptr<Jit::Loop> Jit::compile(const ChunkView&, uint32_t, uint32_t, const Value*) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "interpreter/compiler/chunk.h"
+#include "interpreter/value.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// native code for hot loops. x86-64 on unix only, everywhere else (or with
+// ZENITH_NO_JIT defined) the vm just interprets every loop.
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(ZENITH_NO_JIT)
+#define ZENITH_JIT 1
+#endif
+
+// the vm counts trips round each loop at its OP_LOOP. once one has gone
+// round THRESHOLD times its bytecode, from the top of the loop to the back
+// edge, is translated straight into machine code, provided everything in
+// it works on ints and bools only: locals, constants, arithmetic,
+// comparisons, !, and/or, if/else and nested loops. anything else (a
+// display, a string) and the loop stays interpreted for good.
+//
+// the translation knows every value's type up front, so there are no tag
+// checks left inside the loop. the operand stack becomes a handful of
+// registers, and so do the locals the loop uses most, the rest are read and
+// written in place in the vm's frame. everything is written back to the
+// frame when the loop finishes, the vm carries on after it.
+//
+// the types are whatever the locals held when the loop got hot. they're
+// checked again each time the native loop is entered, and if they don't
+// match that trip runs interpreted. division by zero leaves the native code
+// with the offset of the division, so the vm reports it from the right line
+// exactly as if it had hit it itself.
+//
+// with an interrupt flag, every back edge in the native code checks it and
+// leaves when it's set, so a runaway loop can still be stopped.
+class Jit {
+    public:
+        static constexpr uint32_t THRESHOLD = 1000;
+
+        explicit Jit(const std::atomic<bool>* interrupt = nullptr) : interrupt(interrupt) {}
+        ~Jit();
+
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        // one more trip round loop, true once it's hot enough to run natively
+        bool hot(uint32_t loop) {
+            if (loop >= counts.size()) counts.resize(loop + 1, 0);
+            uint32_t& count = counts[loop];
+            if (count == THRESHOLD) return true;
+            if (count < THRESHOLD) count++;
+            return false;
+        }
+
+        enum class Exit {
+            Interpret,      // not run, carry on at the top of the loop
+            Finished,       // ran to the end, carry on after the back edge
+            DivideByZero,   // fault is the offset of the division
+            Interrupted,    // the flag was set, stopped at a back edge
+        };
+
+        // runs the loop whose back edge sits just before end and jumps to
+        // header, compiling it the first time through
+        Exit run(const ChunkView& chunk, uint32_t loop, uint32_t header, uint32_t end,
+                 Value* locals, uint32_t& fault);
+
+    private:
+        // a local the native code expects to find with a certain tag
+        struct Guard {
+            uint32_t slot;
+            unsigned char tag;
+            bool exact;         // else anything that isn't a heap string will do
+        };
+
+        struct Loop {
+            void* code = nullptr;
+            size_t size = 0;
+            std::vector<Guard> guards;
+        };
+
+        const std::atomic<bool>* interrupt;
+        // trips so far, THRESHOLD once compiled (or worth compiling), past
+        // it for loops that can't be
+        std::vector<uint32_t> counts;
+        std::vector<std::unique_ptr<Loop>> loops;
+
+        std::unique_ptr<Loop> compile(const ChunkView& chunk, uint32_t header, uint32_t end,
+                                      const Value* locals);
+};
+
+#endif
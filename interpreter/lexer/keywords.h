@@ -0,0 +1,98 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include "interpreter/token.h"
+#include <string_view>
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+inline constexpr Keyword KEYWORDS[] = {
+    {"and", AND},
+    {"class", CLASS},
+    {"else", ELSE},
+    {"false", FALSE},
+    {"true", TRUE},
+    {"for", FOR},
+    {"fun", FUN},
+    {"if", IF},
+    {"or", OR},
+    {"display", PRINT},
+    {"return", RETURN},
+    {"super", SUPER},
+    {"this", THIS},
+    {"var", VAR},
+    {"while", WHILE},
+    {"null", NIL},
+    {"int", TYPE_INT},
+    {"string", TYPE_STRING},
+    {"bool", TYPE_BOOL},
+    {"char", TYPE_CHAR},
+};
+
+// the keyword text spells, or IDENTIFIER. length and first letter pick the
+// one candidate it could be, so a name costs a switch and at most one
+// compare, no hashing. keep this in step with KEYWORDS, the static_asserts
+// below catch a keyword missing from the switch.
+constexpr TokenType keywordType(std::string_view text) {
+    auto is = [text](std::string_view keyword, TokenType type) {
+        return text == keyword ? type : IDENTIFIER;
+    };
+    switch (text.size()) {
+        case 2:
+            switch (text[0]) {
+                case 'i': return is("if", IF);
+                case 'o': return is("or", OR);
+            }
+            break;
+        case 3:
+            switch (text[0]) {
+                case 'a': return is("and", AND);
+                case 'f': return text[1] == 'o' ? is("for", FOR) : is("fun", FUN);
+                case 'i': return is("int", TYPE_INT);
+                case 'v': return is("var", VAR);
+            }
+            break;
+        case 4:
+            switch (text[0]) {
+                case 'b': return is("bool", TYPE_BOOL);
+                case 'c': return is("char", TYPE_CHAR);
+                case 'e': return is("else", ELSE);
+                case 'n': return is("null", NIL);
+                case 't': return text[1] == 'h' ? is("this", THIS) : is("true", TRUE);
+            }
+            break;
+        case 5:
+            switch (text[0]) {
+                case 'c': return is("class", CLASS);
+                case 'f': return is("false", FALSE);
+                case 's': return is("super", SUPER);
+                case 'w': return is("while", WHILE);
+            }
+            break;
+        case 6:
+            switch (text[0]) {
+                case 'r': return is("return", RETURN);
+                case 's': return is("string", TYPE_STRING);
+            }
+            break;
+        case 7:
+            return is("display", PRINT);
+    }
+    return IDENTIFIER;
+}
+
+constexpr bool keywordsAllFound() {
+    for (const Keyword& k : KEYWORDS) {
+        if (keywordType(k.text) != k.type) return false;
+    }
+    return true;
+}
+static_assert(keywordsAllFound(), "keywordType is missing a keyword");
+static_assert(keywordType("iff") == IDENTIFIER && keywordType("fox") == IDENTIFIER &&
+              keywordType("thus") == IDENTIFIER && keywordType("displays") == IDENTIFIER,
+              "keywordType matched a plain name");
+
+#endif
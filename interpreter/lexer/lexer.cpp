@@ -1,18 +1,16 @@
 #include "lexer.h"
-#include <iostream>
-#include <cstdlib>
+#include "scan.h"
+#include "keywords.h"
+#include "interpreter/error.h"
 #include <vector>
 #include <string>
 
-using std::cerr;
 using std::vector;
-using std::exit;
 
 
-Lexer::Lexer(const std::string& source) : source(source) {
+Lexer::Lexer(std::string_view source, Interner& interner) : source(source), interner(interner) {
     // the member initializer list ": source(source)" does all the work.
-    // it directly constructs the class's 'source' member with the
-    // 'source' string that was passed into the constructor.
+    // source is only a view, whoever loaded the file keeps the bytes alive.
 }
 
 
@@ -79,8 +77,7 @@ Token Lexer::scanToken() {
     }
 
     // uhhhh what? how did you get here
-    cerr << "Unexpected characater '" << c << "' at line " << line << "\n";
-    exit(1);
+    return fail(std::string("Unexpected characater '") + c + "'");
 }
 
 /// Navigation functions
@@ -105,41 +102,23 @@ char Lexer::peek() const{
     if(isAtEnd()) return '\0';
     return source[current];
 }
-char Lexer::peekNext() const{
-    if(current + 1 >= source.length()) return '\0';
-    return source[current + 1];
-}
 
 void Lexer::skipWhitespace() {
+    const char* p = source.data() + current;
+    const char* end = source.data() + source.size();
     while (true) {
-        char c = peek();
-        switch (c) {
-            // actual empty space
-            case ' ':
-            case '\r':
-            case '\t':
-                advance();
-                break;
-            case '\n':
-                line++;
-                advance();
-                break;
-
-            // comment case
-            case '/':
-                if (peekNext() == '/') {
-                    // comment so skip to EOL
-                    while (peek() != '\n' && !isAtEnd()) advance();
-                } 
-                // division operator
-                else return;
-                break;
-
-            // not a whitespace character. give it back to scanToken();
-            default:
-                return;
+        // actual empty space, newlines bump line on the way
+        p = scan::skipSpace(p, end, line);
+
+        // comment so skip to EOL, the newline is the next round's whitespace
+        if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+            p = scan::findNewline(p + 2, end);
+            continue;
         }
+        // division operator or not whitespace at all. give it back to scanToken();
+        break;
     }
+    current = p - source.data();
 }
 
 
@@ -153,57 +132,60 @@ bool Lexer::isAlpha(char c) const{
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-bool Lexer::isAlphaNumeric(char c) const {
-    return isAlpha(c) || isDigit(c);
-}
-
 Token Lexer::string() {
     // just realised start = current should be in scanToken not here
-    while(peek() != '"' && !isAtEnd()){
-        if(peek() == '\n') line++;
-        advance();
-    }
+    const char* end = source.data() + source.size();
+    scan::Utf8Validator utf8;
+    const char* quote = scan::findQuote(source.data() + current, end, line, utf8);
+    current = quote - source.data();
 
-    if(isAtEnd()){
-        cerr << "Unterminated string at line " << line << "\n";
-        exit(1);  // error means fuck you get out
-    }
+    if(isAtEnd())
+        return fail("Unterminated string");  // error means fuck you get out
+    if(!utf8.valid())
+        return fail("Invalid UTF-8 in string");
 
     // consume the " from the stream
     advance();
-    // token will figure everything else
-    return makeToken(STRING);
+    // token will figure everything else, the interner gets the contents without quotes
+    Token token = makeToken(STRING);
+    token.symbol = interner.intern(token.lexeme.substr(1, token.lexeme.size() - 2));
+    return token;
 }
 
 Token Lexer::number() {
-    while(isDigit(peek())){
-        advance();
-    }
+    current = scan::skipDigits(source.data() + current, source.data() + source.size()) - source.data();
     return makeToken(NUMBER);
 }
 
 Token Lexer::identifier() {
-    while(isAlphaNumeric(peek())){
-        advance();
-    }
+    current = scan::skipIdentifier(source.data() + current, source.data() + source.size()) - source.data();
 
     // find the identifiers contents.
-    // this has to be std::string cuz Lexer::string exists alr
-    std::string_view text(source.data() + start, current - start);
+    std::string_view text = source.substr(start, current - start);
+
+    //if its a keyword return a keyword type
+    TokenType type = keywordType(text);
+    if(type != IDENTIFIER) return makeToken(type);
+    //if its not, return an identifier
+    Token token = makeToken(IDENTIFIER);
+    token.symbol = interner.intern(text);
+    return token;
+}
 
-    auto it = keywords.find(std::string(text));
-    
-    //if its in the map return a keyword type
-    if(it != keywords.end()) return makeToken(it->second);
-    //if its not in the map, return an identifier
-    return makeToken(IDENTIFIER);
+Token Lexer::fail(std::string message) {
+    if (!keepErrors)
+        throw ScriptError(message + " at line " + std::to_string(line) + "\n");
+    // nothing after a bad token is worth scanning
+    error = std::move(message);
+    current = source.size();
+    return makeToken(END_OF_FILE);
 }
 
 Token Lexer::makeToken(TokenType type) const {
     if(type != END_OF_FILE){
         return {
             type,
-            std::string_view(source.data() + start, current - start),
+            source.substr(start, current - start),
             line,
         };
     }else{
@@ -2,59 +2,50 @@
 #define LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 #include "interpreter/token.h"
-
-using keywordMap_t = std::unordered_map<std::string, TokenType>;
+#include "interpreter/interner.h"
 
 class Lexer {
     public: 
-        Lexer(const std::string& source);
+        // borrows source, the tokens' lexemes point into it
+        Lexer(std::string_view source, Interner& interner);
         std::vector<Token> scanTokens();
-        
+        // the next token, END_OF_FILE forever once the source runs out
+        Token scanToken();
+
+        // bad input normally throws a ScriptError. with this on the lexer
+        // notes it and acts like the source ended there instead, for lexers
+        // that see one piece of a file and can't tell if theirs came first
+        void setKeepErrors(bool on) { keepErrors = on; }
+        bool failed() const { return !error.empty(); }
+        // what went wrong, without the " at line N"
+        const std::string& errorMessage() const { return error; }
+        int errorLine() const { return line; }
+
+        // where a piece of a file starts counting from
+        void setLine(int first) { line = first; }
+
     private: 
-        std::string source;
+        std::string_view source;
+        Interner& interner;
         int start = 0; // starting index of any given token
         size_t current = 0; // current index of array
         int line = 1; // line number
+        bool keepErrors = false;
+        std::string error;
 
-        inline static const keywordMap_t keywords = {
-            {"and", AND},
-            {"class", CLASS},
-            {"else", ELSE},
-            {"false", FALSE},
-            {"true", TRUE},
-            {"for", FOR},
-            {"fun", FUN},
-            {"if", IF},
-            {"or", OR},
-            {"display", PRINT},
-            {"return", RETURN},
-            {"super", SUPER},
-            {"this", THIS},
-            {"var", VAR},
-            {"while", WHILE},
-            {"null", NIL},
-            {"int", TYPE_INT},
-            {"string", TYPE_STRING},
-            {"bool", TYPE_BOOL},
-            {"char", TYPE_CHAR},
-        };
-        
-        
         // navigation methods
         char advance();
         bool match(char expected);
         bool isAtEnd() const;
         char peek() const;
-        char peekNext() const;
         void skipWhitespace();
 
         // classification methods
         bool isDigit(char c) const;
         bool isAlpha(char c) const;
-        bool isAlphaNumeric(char c) const;
         
         // token methods
         Token string();
@@ -62,9 +53,7 @@ class Lexer {
         Token identifier();
         
         Token makeToken(TokenType type) const;
-        Token makeToken(TokenType type, std::string lexeme) const;
-        
-        Token scanToken();
+        Token fail(std::string message);
 
 };
 
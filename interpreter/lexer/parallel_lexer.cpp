@@ -0,0 +1,129 @@
+#include "parallel_lexer.h"
+#include "lexer.h"
+#include "scan.h"
+#include "interpreter/parallel.h"
+#include "interpreter/error.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+
+// pieces smaller than this cost more to hand out than they save
+constexpr size_t MIN_PIECE = 1 << 20;
+// a few pieces per thread, so one slow piece doesn't leave the rest idle
+constexpr size_t PIECES_PER_THREAD = 4;
+
+// where the pieces start: just past a newline that's outside any string or
+// comment, at or after each evenly spaced target. it only stops where a
+// string or comment could begin or end, so it runs far ahead of the lexer.
+// the last entry is the end of the source
+std::vector<size_t> cutPoints(std::string_view source, size_t pieces) {
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    size_t step = source.size() / pieces;
+    size_t target = step;
+
+    std::vector<size_t> cuts{0};
+    const char* p = begin;
+    while (cuts.size() < pieces && p < end) {
+        // plain code from p up to next, any newline in it will do
+        const char* next = scan::findQuoteOrSlash(p, end);
+        while (cuts.size() < pieces) {
+            const char* from = std::max(p, begin + target);
+            if (from >= next) break;
+            const char* newline = scan::findNewline(from, next);
+            if (newline == next) break;
+            cuts.push_back(static_cast<size_t>(newline + 1 - begin));
+            target = std::max(target + step, cuts.back());
+        }
+
+        if (next == end) break;
+        if (*next == '"') {
+            // the lexer takes everything up to the next quote, newlines and all
+            auto close = static_cast<const char*>(std::memchr(next + 1, '"', end - next - 1));
+            if (!close) break; // unterminated, the last piece gets to report it
+            p = close + 1;
+        } else if (end - next >= 2 && next[1] == '/') {
+            // the newline ending a comment is back in plain code
+            p = scan::findNewline(next + 2, end);
+        } else {
+            p = next + 1; // just a slash
+        }
+    }
+    cuts.push_back(source.size());
+    return cuts;
+}
+
+struct Piece {
+    std::string_view text;
+    std::vector<Token> tokens;  // without the END_OF_FILE
+    int lastLine = 1;           // counting from 1 at the start of the piece
+    std::string error;
+    int errorLine = 0;
+};
+
+void lexPiece(Piece& piece, Interner& interner) {
+    Lexer lexer(piece.text, interner);
+    lexer.setKeepErrors(true);
+    // growing the vector a doubling at a time copies and faults in every
+    // token again. a guess on the high side costs nothing, the pages past
+    // the end are never touched
+    piece.tokens.reserve(piece.text.size() / 3 + 16);
+    while (true) {
+        Token token = lexer.scanToken();
+        if (token.type == END_OF_FILE) {
+            piece.lastLine = token.line;
+            break;
+        }
+        piece.tokens.push_back(token);
+    }
+    if (lexer.failed()) {
+        piece.error = lexer.errorMessage();
+        piece.errorLine = lexer.errorLine();
+    }
+}
+
+} // namespace
+
+std::vector<std::vector<Token>> scanTokensParallel(std::string_view source, Interner& interner,
+                                                   unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t count = std::min(threads * PIECES_PER_THREAD, source.size() / MIN_PIECE);
+    if (count < 2) return {Lexer(source, interner).scanTokens()};
+
+    std::vector<size_t> cuts = cutPoints(source, count);
+    count = cuts.size() - 1;
+    std::vector<Piece> pieces(count);
+    std::vector<Interner> interners(count);
+    for (size_t i = 0; i < count; i++)
+        pieces[i].text = source.substr(cuts[i], cuts[i + 1] - cuts[i]);
+
+    parallelFor(count, threads, [&](size_t i) { lexPiece(pieces[i], interners[i]); });
+
+    std::vector<int> lineOffset(count, 0);
+    for (size_t i = 0; i < count; i++) {
+        if (!pieces[i].error.empty()) {
+            // whatever came after the first bad token is moot
+            throw ScriptError(pieces[i].error + " at line "
+                              + std::to_string(pieces[i].errorLine + lineOffset[i]) + "\n");
+        }
+        if (i + 1 < count) lineOffset[i + 1] = lineOffset[i] + pieces[i].lastLine - 1;
+    }
+
+    std::vector<std::vector<Symbol>> symbols = interner.absorb(interners, threads);
+
+    // the tokens are fixed up where they are, each piece on its own
+    parallelFor(count, threads, [&](size_t i) {
+        for (Token& t : pieces[i].tokens) {
+            t.line += lineOffset[i];
+            if (t.symbol != NO_SYMBOL) t.symbol = symbols[i][t.symbol];
+        }
+    });
+
+    std::vector<std::vector<Token>> tokens(count);
+    for (size_t i = 0; i < count; i++) tokens[i] = std::move(pieces[i].tokens);
+    tokens.back().push_back({END_OF_FILE, "EOF", lineOffset.back() + pieces.back().lastLine});
+    return tokens;
+}
@@ -0,0 +1,35 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include "interpreter/interner.h"
+#include "interpreter/token.h"
+#include <string_view>
+#include <vector>
+
+// Lexer::scanTokens spread over several threads, for generated scripts big
+// enough that lexing them dominates startup.
+//
+// a quick pre-scan finds newlines that aren't inside a string or a comment,
+// the source is cut there into pieces, and each piece gets its own Lexer and
+// Interner on a worker thread. stitching the pieces back together is what
+// keeps the result identical to the serial lexer, token for token:
+//
+//   lines    every piece counts from 1, and a running sum of the lines
+//            before it gets added to its tokens
+//   symbols  the pieces' interners are absorbed into the real one, which
+//            numbers their texts the way the serial lexer would have, first
+//            seen first numbered (Interner::absorb). tokens are remapped
+//   errors   a piece that hits bad input stops there. the first one in the
+//            file gets reported, with its real line, just like serially
+//
+// the tokens come back in pieces: read back to back (TokenStream does) they
+// are exactly what scanTokens returns, END_OF_FILE at the end of the last.
+// gluing them into one vector would be a serial pass over several times
+// the size of the source, enough to undo most of what the threads bought.
+// small sources aren't worth the threads and come back as one piece.
+//
+// threads = 0 means one per core
+std::vector<std::vector<Token>> scanTokensParallel(std::string_view source, Interner& interner,
+                                                   unsigned threads = 0);
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+// the lexer's inner loops. each one looks at a run of bytes and returns
+// where the run ends, 32 bytes at a time with avx2, 16 with sse2, one at a
+// time otherwise. vector loads never go past end, the last few bytes of the
+// source always take the scalar loop.
+//
+// define ZENITH_NO_SIMD to force the scalar loops.
+#if !defined(ZENITH_NO_SIMD) && defined(__AVX2__)
+#define ZENITH_SCAN_AVX2 1
+#include <immintrin.h>
+#elif !defined(ZENITH_NO_SIMD) && defined(__SSE2__)
+#define ZENITH_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace scan {
+
+// checks utf-8 a byte at a time, carrying state across calls so a sequence
+// can be split between two blocks. rejects overlongs, surrogates and
+// anything past U+10FFFF
+struct Utf8Validator {
+    uint8_t need = 0;   // continuation bytes still expected
+    uint8_t lo = 0x80;  // allowed range for the next continuation byte
+    uint8_t hi = 0xBF;
+    bool ok = true;
+
+    void feed(unsigned char c) {
+        if (need) {
+            if (c < lo || c > hi) ok = false;
+            lo = 0x80;
+            hi = 0xBF;
+            need--;
+            return;
+        }
+        if (c < 0x80) return;
+        if (c >= 0xC2 && c <= 0xDF)      need = 1;
+        else if (c == 0xE0)              { need = 2; lo = 0xA0; }
+        else if (c == 0xED)              { need = 2; hi = 0x9F; }
+        else if (c >= 0xE1 && c <= 0xEF) need = 2;
+        else if (c == 0xF0)              { need = 3; lo = 0x90; }
+        else if (c == 0xF4)              { need = 3; hi = 0x8F; }
+        else if (c >= 0xF1 && c <= 0xF3) need = 3;
+        else ok = false;
+    }
+
+    bool valid() const { return ok && need == 0; }
+};
+
+// most runs are a few bytes long (one space, a short name), so every
+// scanner looks at this many bytes one at a time before it bothers with
+// vector loads
+constexpr int SHORT_RUN = 8;
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isIdentifier(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || isDigit(c);
+}
+
+#if defined(ZENITH_SCAN_AVX2)
+
+using Block = __m256i;
+constexpr size_t BLOCK = 32;
+using Mask = uint32_t;
+
+inline Block load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const Block*>(p)); }
+inline Block splat(char c) { return _mm256_set1_epi8(c); }
+inline Block eq(Block a, char c) { return _mm256_cmpeq_epi8(a, splat(c)); }
+inline Block either(Block a, Block b) { return _mm256_or_si256(a, b); }
+inline Mask bits(Block a) { return static_cast<Mask>(_mm256_movemask_epi8(a)); }
+// lo <= byte <= hi, unsigned
+inline Block inRange(Block a, char lo, char hi) {
+    Block shifted = _mm256_sub_epi8(a, splat(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, splat(static_cast<char>(hi - lo))), shifted);
+}
+inline Block lower(Block a) { return _mm256_or_si256(a, splat(0x20)); }
+
+#elif defined(ZENITH_SCAN_SSE2)
+
+using Block = __m128i;
+constexpr size_t BLOCK = 16;
+using Mask = uint32_t;
+
+inline Block load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const Block*>(p)); }
+inline Block splat(char c) { return _mm_set1_epi8(c); }
+inline Block eq(Block a, char c) { return _mm_cmpeq_epi8(a, splat(c)); }
+inline Block either(Block a, Block b) { return _mm_or_si128(a, b); }
+inline Mask bits(Block a) { return static_cast<Mask>(_mm_movemask_epi8(a)); }
+inline Block inRange(Block a, char lo, char hi) {
+    Block shifted = _mm_sub_epi8(a, splat(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, splat(static_cast<char>(hi - lo))), shifted);
+}
+inline Block lower(Block a) { return _mm_or_si128(a, splat(0x20)); }
+
+#endif
+
+#if defined(ZENITH_SCAN_AVX2) || defined(ZENITH_SCAN_SSE2)
+#define ZENITH_SCAN_SIMD 1
+
+constexpr Mask ALL = static_cast<Mask>(~uint64_t(0) >> (64 - BLOCK));
+
+inline unsigned firstSet(Mask m) { return static_cast<unsigned>(__builtin_ctz(m)); }
+inline int countSet(Mask m) { return __builtin_popcount(m); }
+inline Mask below(unsigned n) { return n >= 32 ? ~Mask(0) : (Mask(1) << n) - 1; }
+
+inline Mask spaceBits(Block b) {
+    return bits(either(either(eq(b, ' '), eq(b, '\t')), either(eq(b, '\r'), eq(b, '\n'))));
+}
+inline Mask identifierBits(Block b) {
+    return bits(either(either(inRange(lower(b), 'a', 'z'), inRange(b, '0', '9')), eq(b, '_')));
+}
+#endif
+
+// end of a run of spaces, tabs and newlines. line goes up by the newlines in it
+inline const char* skipSpace(const char* p, const char* end, int& line) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (p == end || !isSpace(*p)) return p;
+        if (*p == '\n') line++;
+    }
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        Block b = load(p);
+        Mask newlines = bits(eq(b, '\n'));
+        Mask stop = ~spaceBits(b) & ALL;
+        if (stop) {
+            unsigned n = firstSet(stop);
+            line += countSet(newlines & below(n));
+            return p + n;
+        }
+        line += countSet(newlines);
+        p += BLOCK;
+    }
+#endif
+    while (p < end && isSpace(*p)) {
+        if (*p == '\n') line++;
+        p++;
+    }
+    return p;
+}
+
+// the newline that ends a // comment, or end
+inline const char* findNewline(const char* p, const char* end) {
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        if (Mask hit = bits(eq(load(p), '\n'))) return p + firstSet(hit);
+        p += BLOCK;
+    }
+#endif
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+inline const char* skipIdentifier(const char* p, const char* end) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (p == end || !isIdentifier(*p)) return p;
+    }
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        Mask stop = ~identifierBits(load(p)) & ALL;
+        if (stop) return p + firstSet(stop);
+        p += BLOCK;
+    }
+#endif
+    while (p < end && isIdentifier(*p)) p++;
+    return p;
+}
+
+inline const char* skipDigits(const char* p, const char* end) {
+    for (int i = 0; i < SHORT_RUN; i++, p++) {
+        if (p == end || !isDigit(*p)) return p;
+    }
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        Mask stop = ~bits(inRange(load(p), '0', '9')) & ALL;
+        if (stop) return p + firstSet(stop);
+        p += BLOCK;
+    }
+#endif
+    while (p < end && isDigit(*p)) p++;
+    return p;
+}
+
+// the closing quote of a string whose contents start at p, or end if it's
+// unterminated. counts the newlines inside and checks the contents are utf-8
+// on the way, blocks of plain ascii skip the validator entirely
+inline const char* findQuote(const char* p, const char* end, int& line, Utf8Validator& utf8) {
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        Block b = load(p);
+        Mask quote = bits(eq(b, '"'));
+        Mask newlines = bits(eq(b, '\n'));
+        Mask high = bits(b); // top bit set, not ascii
+        unsigned n = quote ? firstSet(quote) : static_cast<unsigned>(BLOCK);
+        Mask inside = below(n);
+        line += countSet(newlines & inside);
+        if ((high & inside) || utf8.need) {
+            for (unsigned i = 0; i < n; i++) utf8.feed(static_cast<unsigned char>(p[i]));
+        }
+        if (quote) return p + n;
+        p += BLOCK;
+    }
+#endif
+    while (p < end && *p != '"') {
+        if (*p == '\n') line++;
+        utf8.feed(static_cast<unsigned char>(*p));
+        p++;
+    }
+    return p;
+}
+
+// the next place a string or a comment could start, or end. for the
+// parallel lexer's pre-scan, which only cares where those are
+inline const char* findQuoteOrSlash(const char* p, const char* end) {
+#ifdef ZENITH_SCAN_SIMD
+    while (static_cast<size_t>(end - p) >= BLOCK) {
+        Block b = load(p);
+        if (Mask hit = bits(either(eq(b, '"'), eq(b, '/')))) return p + firstSet(hit);
+        p += BLOCK;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '/') p++;
+    return p;
+}
+
+} // namespace scan
+
+#endif
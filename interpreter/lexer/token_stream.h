@@ -0,0 +1,71 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include "interpreter/lexer/lexer.h"
+#include "interpreter/token.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// the parser pulls tokens through this instead of the lexer scanning the
+// whole file up front, so only a handful of tokens exist at any time no
+// matter how big the script is. the ring holds the token just consumed
+// (for previous()), the current one, and a little lookahead.
+//
+// references are only good until the stream moves a few tokens further
+// along, copy a token if it has to live longer than that.
+class TokenStream {
+    public:
+        static constexpr size_t RING_SIZE = 4; // power of two
+        static constexpr size_t MAX_LOOKAHEAD = RING_SIZE - 2;
+
+        explicit TokenStream(Lexer& lexer) : lexer(&lexer) {}
+        // replays tokens scanned earlier, the last one has to be END_OF_FILE
+        explicit TokenStream(const std::vector<Token>& tokens) : scanned(&tokens), pieces(1) {}
+        // same for tokens that come in pieces, read back to back (see parallel_lexer.h)
+        explicit TokenStream(const std::vector<std::vector<Token>>& tokens)
+            : scanned(tokens.data()), pieces(tokens.size()) {}
+
+        // ahead = 0 is the current token
+        const Token& peek(size_t ahead = 0) {
+            while (fetched <= head + ahead) {
+                ring[fetched & MASK] = lexer ? lexer->scanToken() : replay();
+                fetched++;
+            }
+            return ring[(head + ahead) & MASK];
+        }
+
+        // the token advance() last stepped over
+        const Token& previous() const { return ring[(head - 1) & MASK]; }
+
+        // END_OF_FILE is sticky, advancing past it stays on it
+        const Token& advance() {
+            if (peek().type != END_OF_FILE) head++;
+            return previous();
+        }
+
+    private:
+        static constexpr size_t MASK = RING_SIZE - 1;
+        static_assert((RING_SIZE & MASK) == 0, "RING_SIZE has to be a power of two");
+
+        Lexer* lexer = nullptr;
+        const std::vector<Token>* scanned = nullptr;
+        size_t pieces = 0;
+        size_t piece = 0;   // where replay() is up to
+        size_t index = 0;
+        Token ring[RING_SIZE] = {};
+        size_t head = 0;    // how many tokens have been consumed
+        size_t fetched = 0; // how many the lexer has produced
+
+        // the last token repeats once they run out, it's END_OF_FILE
+        const Token& replay() {
+            while (index == scanned[piece].size() && piece + 1 < pieces) {
+                piece++;
+                index = 0;
+            }
+            const std::vector<Token>& current = scanned[piece];
+            return current[std::min(index++, current.size() - 1)];
+        }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "output.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+Output::Output(int fd)
+    : Output(fd, isatty(fd) ? FlushPolicy::Line : FlushPolicy::Block) {}
+
+Output::Output(int fd, FlushPolicy policy)
+    : fd(fd), policy(policy), buffer(std::make_unique<char[]>(BUFFER_SIZE)) {}
+
+Output::Output(std::string& sink)
+    : Output([&sink](std::string_view text) { sink.append(text); }) {}
+
+Output::Output(std::function<void(std::string_view)> sink)
+    : fd(-1), sink(std::move(sink)), policy(FlushPolicy::Block), buffer(std::make_unique<char[]>(BUFFER_SIZE)) {}
+
+Output::~Output() {
+    flush();
+}
+
+void Output::write(std::string_view text) {
+    if (used + text.size() > BUFFER_SIZE) {
+        flush();
+        // bigger than the whole buffer, no point copying it in
+        if (text.size() > BUFFER_SIZE) {
+            writeAll(text.data(), text.size());
+            return;
+        }
+    }
+    std::memcpy(buffer.get() + used, text.data(), text.size());
+    used += text.size();
+}
+
+void Output::display(const Value& v) {
+    switch (v.type()) {
+        case ValueType::Int: {
+            // 11 chars covers INT_MIN, plus the newline
+            if (used + 12 > BUFFER_SIZE) flush();
+            char* at = buffer.get() + used;
+            auto result = std::to_chars(at, at + 11, v.asInt());
+            used += result.ptr - at;
+            break;
+        }
+        case ValueType::Bool:   write(v.asBool() ? "true" : "false"); break;
+        case ValueType::String: write(v.asString()); break;
+        case ValueType::Char: {
+            char c = v.asChar();
+            write(std::string_view(&c, 1));
+            break;
+        }
+        case ValueType::Null:   write("null"); break;
+    }
+    endLine();
+}
+
+void Output::endLine() {
+    if (used == BUFFER_SIZE) flush();
+    buffer[used++] = '\n';
+    if (policy != FlushPolicy::Block) flush();
+    else if (used == BUFFER_SIZE) flush();
+}
+
+void Output::flush() {
+    if (used == 0) return;
+    writeAll(buffer.get(), used);
+    used = 0;
+}
+
+void Output::writeAll(const char* data, size_t size) {
+    if (sink) {
+        sink(std::string_view(data, size));
+        return;
+    }
+    while (size > 0) {
+        auto written = ::write(fd, data, static_cast<unsigned>(size > (1u << 30) ? (1u << 30) : size));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return; // nowhere left to report it, stdout is gone
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+Output& standardOutput() {
+    static Output out(1);
+    return out;
+}
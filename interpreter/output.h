@@ -0,0 +1,60 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "interpreter/value.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// where display() goes. text is collected in one reusable buffer and handed
+// to the file descriptor in big writes instead of one stream insertion per
+// value, and ints are formatted straight into the buffer.
+class Output {
+    public:
+        enum class FlushPolicy {
+            Line,   // flush after every newline, for a person watching a terminal
+            Block,  // flush only when the buffer fills up, for pipes and files
+            None,   // write straight through
+        };
+
+        static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+        // line buffered if fd is a terminal, block buffered otherwise
+        explicit Output(int fd);
+        Output(int fd, FlushPolicy policy);
+        // collects everything in sink instead, for --jobs, which holds each
+        // script's output until it's that script's turn to print
+        explicit Output(std::string& sink);
+        // hands each full buffer to sink, for embedders (zenith.h)
+        explicit Output(std::function<void(std::string_view)> sink);
+        ~Output();
+
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+
+        void write(std::string_view text);
+        // the display statement: the value and a newline
+        void display(const Value& v);
+        void flush();
+
+        void setPolicy(FlushPolicy p) { policy = p; }
+        FlushPolicy getPolicy() const { return policy; }
+
+    private:
+        int fd;
+        std::function<void(std::string_view)> sink;
+        FlushPolicy policy;
+        std::unique_ptr<char[]> buffer;
+        size_t used = 0;
+
+        void writeAll(const char* data, size_t size);
+        void endLine();
+};
+
+// stdout for the whole process. it's flushed when the process exits, but
+// anything about to print an error should flush it first so the program's
+// output comes out before the error does.
+Output& standardOutput();
+
+#endif
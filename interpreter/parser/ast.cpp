@@ -0,0 +1,40 @@
+#include "ast.h"
+
+NodeId Ast::addLiteral(const Token& op, Value value) {
+    constants.push_back(std::move(value));
+    return add(LiteralExpression{op, static_cast<uint32_t>(constants.size() - 1)});
+}
+
+int Ast::lineOf(NodeId stmt) const {
+    switch (kindOf(stmt)) {
+        case NodeKind::Print:          return get<PrintStatement>(stmt).line;
+        case NodeKind::VarDecl:        return get<VarDeclStatement>(stmt).line;
+        case NodeKind::Block:          return get<BlockStatement>(stmt).line;
+        case NodeKind::If:             return get<IfStatement>(stmt).line;
+        case NodeKind::While:          return get<WhileStatement>(stmt).line;
+        case NodeKind::For:            return get<ForStatement>(stmt).line;
+        case NodeKind::ExpressionStmt: return get<ExpressionStatement>(stmt).line;
+        default:                       return 0;
+    }
+}
+
+StaticType Ast::typeOf(NodeId expr) const {
+    switch (kindOf(expr)) {
+        case NodeKind::Literal: {
+            const Value& v = constants[get<LiteralExpression>(expr).constant];
+            switch (v.type()) {
+                case ValueType::Null:   return StaticType::Null;
+                case ValueType::Int:    return StaticType::Int;
+                case ValueType::Bool:   return StaticType::Bool;
+                case ValueType::Char:   return StaticType::Char;
+                case ValueType::String: return StaticType::String;
+            }
+            return StaticType::Dynamic;
+        }
+        case NodeKind::Binary:     return get<BinaryExpression>(expr).type;
+        case NodeKind::Unary:      return get<UnaryExpression>(expr).type;
+        case NodeKind::Identifier: return get<IdentifierExpression>(expr).type;
+        case NodeKind::Assignment: return get<AssignmentExpression>(expr).type;
+        default:                   return StaticType::Dynamic;
+    }
+}
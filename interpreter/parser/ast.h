@@ -0,0 +1,226 @@
+#ifndef AST_H
+#define AST_H
+
+#include "interpreter/token.h"
+#include "interpreter/value.h"
+#include "interpreter/error.h"
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+// the whole tree lives in one Ast. every node kind gets its own contiguous
+// pool and children point at each other with 32 bit ids instead of owning
+// pointers, so parsing is a handful of vector growths and freeing the
+// program is dropping the Ast.
+
+enum class NodeKind : uint8_t {
+    // expressions
+    Binary, Unary, Literal, Identifier, Assignment,
+    // statements
+    Print, VarDecl, Block, If, While, For, ExpressionStmt,
+};
+
+// top 4 bits are the kind, the rest is the index into that kind's pool
+using NodeId = uint32_t;
+constexpr NodeId NO_NODE = UINT32_MAX;
+constexpr uint32_t NODE_INDEX_BITS = 28;
+constexpr uint32_t MAX_NODES_PER_KIND = (1u << NODE_INDEX_BITS) - 1;
+
+inline NodeKind kindOf(NodeId id) { return static_cast<NodeKind>(id >> NODE_INDEX_BITS); }
+inline uint32_t indexOf(NodeId id) { return id & MAX_NODES_PER_KIND; }
+
+// what an expression always evaluates to, worked out by the checker before
+// anything runs. Dynamic is anything at all, which only running it tells
+enum class StaticType : uint8_t { Dynamic, Null, Int, Bool, Char, String };
+
+// what a variable declared with the type keyword holds
+inline StaticType declaredType(TokenType keyword) {
+    switch (keyword) {
+        case TYPE_INT:    return StaticType::Int;
+        case TYPE_BOOL:   return StaticType::Bool;
+        case TYPE_CHAR:   return StaticType::Char;
+        case TYPE_STRING: return StaticType::String;
+        default:          return StaticType::Dynamic;
+    }
+}
+
+// expressions
+
+// every expression but a literal (whose type is its value's) carries its
+// static type, filled in by the checker
+struct BinaryExpression {
+    static constexpr NodeKind kind = NodeKind::Binary;
+    NodeId left;
+    NodeId right;
+    Token op;
+    StaticType type = StaticType::Dynamic;
+};
+struct UnaryExpression {
+    static constexpr NodeKind kind = NodeKind::Unary;
+    NodeId expr;
+    Token op;
+    StaticType type = StaticType::Dynamic;
+};
+// decoded once by the parser, the value is ast.constants[constant]
+struct LiteralExpression {
+    static constexpr NodeKind kind = NodeKind::Literal;
+    Token op;
+    uint32_t constant;
+};
+// depth is how many scopes out the variable lives, slot is its index in that
+// scope. both are filled in by the resolver. variable numbers every variable
+// in the program uniquely, unlike slots, and is filled in by the checker
+struct IdentifierExpression {
+    static constexpr NodeKind kind = NodeKind::Identifier;
+    Token name;
+    int depth = -1;
+    int slot = -1;
+    StaticType type = StaticType::Dynamic;
+    uint32_t variable = UINT32_MAX;
+};
+struct AssignmentExpression {
+    static constexpr NodeKind kind = NodeKind::Assignment;
+    Token name;
+    NodeId value;
+    int depth = -1;
+    int slot = -1;
+    StaticType type = StaticType::Dynamic;
+    uint32_t variable = UINT32_MAX;
+};
+
+// statements. line is where the statement starts, for tools that report
+// per statement (the profiler)
+
+// display(expr)
+struct PrintStatement {
+    static constexpr NodeKind kind = NodeKind::Print;
+    NodeId expr;
+    int line = 0;
+};
+
+// type x = expr;
+struct VarDeclStatement {
+    static constexpr NodeKind kind = NodeKind::VarDecl;
+    TokenType typeKeyword;
+    Token name;
+    NodeId initialiser;
+    int slot = -1; // set by the resolver
+    // the variable's, for as long as it lives: the declared type, or
+    // Dynamic if it's ever assigned anything else. set by the checker,
+    // like its number
+    StaticType type = StaticType::Dynamic;
+    uint32_t variable = UINT32_MAX;
+    int line = 0;
+};
+
+// {statement*}, the statements are ast.lists[first .. first + count)
+struct BlockStatement {
+    static constexpr NodeKind kind = NodeKind::Block;
+    uint32_t first;
+    uint32_t count;
+    int slotCount = 0; // variables declared directly in this block, set by the resolver
+    int line = 0;
+};
+
+// if (expr) block (else)?
+struct IfStatement {
+    static constexpr NodeKind kind = NodeKind::If;
+    NodeId condition;
+    NodeId thenBranch;
+    NodeId elseBranch; // NO_NODE if no else
+    int line = 0;
+};
+
+// while (expr) block
+struct WhileStatement {
+    static constexpr NodeKind kind = NodeKind::While;
+    NodeId condition;
+    NodeId body;
+    int line = 0;
+};
+
+// for (expr; expr; expr;) block
+struct ForStatement {
+    static constexpr NodeKind kind = NodeKind::For;
+    NodeId init;
+    NodeId condition;
+    NodeId increment;
+    NodeId body;
+    int line = 0;
+};
+
+// expr;
+struct ExpressionStatement {
+    static constexpr NodeKind kind = NodeKind::ExpressionStmt;
+    NodeId expr;
+    int line = 0;
+};
+
+class Ast {
+    public:
+        // top level statements, in order
+        std::vector<NodeId> statements;
+        // child lists of blocks, each block owns a contiguous run
+        std::vector<NodeId> lists;
+        // literal values, already decoded
+        std::vector<Value> constants;
+
+        NodeId addLiteral(const Token& op, Value value);
+
+        // the line a statement starts on
+        int lineOf(NodeId stmt) const;
+        // an expression's static type, Dynamic until the checker has run
+        StaticType typeOf(NodeId expr) const;
+
+        // every node in every pool
+        size_t nodeCount() const {
+            return std::apply([](const auto&... pool) { return (pool.size() + ...); }, pools);
+        }
+
+        template <typename Node>
+        NodeId add(Node node) {
+            auto& pool = std::get<std::vector<Node>>(pools);
+            if (pool.size() >= MAX_NODES_PER_KIND)
+                throw ScriptError("[ERROR] Program too large, ran out of node ids.\n");
+            pool.push_back(std::move(node));
+            return (static_cast<NodeId>(Node::kind) << NODE_INDEX_BITS)
+                 | static_cast<NodeId>(pool.size() - 1);
+        }
+
+        template <typename Node>
+        Node& get(NodeId id) {
+            return std::get<std::vector<Node>>(pools)[indexOf(id)];
+        }
+
+        template <typename Node>
+        const Node& get(NodeId id) const {
+            return std::get<std::vector<Node>>(pools)[indexOf(id)];
+        }
+
+        template <typename Node>
+        size_t count() const {
+            return std::get<std::vector<Node>>(pools).size();
+        }
+
+        // the statements of a block
+        const NodeId* begin(const BlockStatement& block) const { return lists.data() + block.first; }
+        const NodeId* end(const BlockStatement& block) const { return lists.data() + block.first + block.count; }
+
+    private:
+        std::tuple<
+            std::vector<BinaryExpression>,
+            std::vector<UnaryExpression>,
+            std::vector<LiteralExpression>,
+            std::vector<IdentifierExpression>,
+            std::vector<AssignmentExpression>,
+            std::vector<PrintStatement>,
+            std::vector<VarDeclStatement>,
+            std::vector<BlockStatement>,
+            std::vector<IfStatement>,
+            std::vector<WhileStatement>,
+            std::vector<ForStatement>,
+            std::vector<ExpressionStatement>
+        > pools;
+};
+
+#endif
@@ -1,31 +1,11 @@
 #include <string>
 #include <vector>
-#include <memory>
 #include <cstdlib>
-#include <iostream>
-#include <stdexcept>
+#include <charconv>
 #include "interpreter/token.h"
+#include "interpreter/error.h"
 #include "parser.h"
 
-// only use this to access token stream
-Token Parser::peek() const {
-    return tokens.at(current);
-}
-
-// this works
-bool Parser::isAtEnd() const {
-    return peek().type == END_OF_FILE;
-}
-
-Token Parser::previous() const {
-    return tokens.at(current - 1);
-}
-
-Token Parser::advance() {
-    if (!isAtEnd()) current++;
-    return previous();
-}
-
 bool Parser::match(TokenType type) {
     if (check(type)) {
         advance();
@@ -34,35 +14,36 @@ bool Parser::match(TokenType type) {
     return false;
 }
 
-bool Parser::check(TokenType type) const {
+bool Parser::check(TokenType type) {
     if (isAtEnd()) return false;
     return peek().type == type;
 }
 
-Token Parser::consume(TokenType type, const std::string& message) {
+const Token& Parser::consume(TokenType type, const std::string& message) {
     if (check(type)) return advance();
+    error(peek(), message);
+}
 
-    std::cerr << "[line " << peek().line << "] Error: " << message << std::endl;
-    std::exit(1);
+void Parser::error(const Token& at, const std::string& message) {
+    throw ScriptError("[line " + std::to_string(at.line) + "] Error: " + message + "\n");
 }
 
-bool Parser::isTypeKeyword() const {
+bool Parser::isTypeKeyword() {
     TokenType t = peek().type;
     return t == TYPE_INT || t == TYPE_STRING || t == TYPE_BOOL || t == TYPE_CHAR;
 }
 
 
 // top level
-std::vector<unique_ptr<Statement>> Parser::parse() {
-    std::vector<unique_ptr<Statement>> statements;
+Ast Parser::parse() {
     while (!isAtEnd()){
-        statements.push_back(parseStatement());
+        ast.statements.push_back(parseStatement());
     }
-    return statements;
+    return std::move(ast);
 }
 
 // statement parsing
-unique_ptr<Statement> Parser::parseStatement() {
+NodeId Parser::parseStatement() {
     if (isTypeKeyword())        return parseVarDecl();
     if (match(PRINT))           return parsePrintStatement();
     if (match(IF))              return parseIfStatement();
@@ -73,41 +54,44 @@ unique_ptr<Statement> Parser::parseStatement() {
 }
 
 // int x = expr;
-unique_ptr<Statement> Parser::parseVarDecl() {
-    TokenType typeKeyword = advance().type;  // consume type
+NodeId Parser::parseVarDecl() {
+    const Token& type = advance();  // consume type
+    TokenType typeKeyword = type.type;
+    int line = type.line;
     Token name = consume(IDENTIFIER, "Expected variable name after type.");
     consume(EQUAL, "Expected '=' after variable name.");
     auto initialiser = parseExpression();
     consume(SEMICOLON, "Expected ';' after variable declaration.");
 
-    auto decl = std::make_unique<VarDeclStatement>();
-    decl->typeKeyword = typeKeyword;
-    decl->name = name;
-    decl->initialiser = std::move(initialiser);
-    return decl;
+    VarDeclStatement decl;
+    decl.typeKeyword = typeKeyword;
+    decl.name = name;
+    decl.initialiser = initialiser;
+    decl.line = line;
+    return ast.add(decl);
 }
 
 // display(expr);
-unique_ptr<Statement> Parser::parsePrintStatement() {
+NodeId Parser::parsePrintStatement() {
+    int line = previous().line;  // display
     consume(LEFT_PAREN, "Expected '(' after 'display'.");
     auto expr = parseExpression();
     consume(RIGHT_PAREN, "Expected ')' after expression.");
     consume(SEMICOLON, "Expected ';' after display statement.");
 
-    auto stmt = std::make_unique<PrintStatement>();
-    stmt->expr = std::move(expr);
-    return stmt;
+    return ast.add(PrintStatement{expr, line});
 }
 
 // if (expr) block (else block)?
-unique_ptr<Statement> Parser::parseIfStatement() {
+NodeId Parser::parseIfStatement() {
+    int line = previous().line;  // if
     consume(LEFT_PAREN, "Expected '(' after 'if'.");
     auto condition = parseExpression();
     consume(RIGHT_PAREN, "Expected ')' after if condition.");
 
     auto thenBranch = parseBlock();
 
-    unique_ptr<Statement> elseBranch = nullptr;
+    NodeId elseBranch = NO_NODE;
     if (match(ELSE)) {
         // else if is just an else whose body is another if statement
         if (check(IF)) {
@@ -118,28 +102,23 @@ unique_ptr<Statement> Parser::parseIfStatement() {
         }
     }
 
-    auto stmt = std::make_unique<IfStatement>();
-    stmt->condition = std::move(condition);
-    stmt->thenBranch = std::move(thenBranch);
-    stmt->elseBranch = std::move(elseBranch);
-    return stmt;
+    return ast.add(IfStatement{condition, thenBranch, elseBranch, line});
 }
 
 // while (expr) block
-unique_ptr<Statement> Parser::parseWhileStatement() {
+NodeId Parser::parseWhileStatement() {
+    int line = previous().line;  // while
     consume(LEFT_PAREN, "Expected '(' after 'while'.");
     auto condition = parseExpression();
     consume(RIGHT_PAREN, "Expected ')' after while condition.");
     auto body = parseBlock();
 
-    auto stmt = std::make_unique<WhileStatement>();
-    stmt->condition = std::move(condition);
-    stmt->body = std::move(body);
-    return stmt;
+    return ast.add(WhileStatement{condition, body, line});
 }
 
 // for (expr; expr; expr) block
-unique_ptr<Statement> Parser::parseForStatement() {
+NodeId Parser::parseForStatement() {
+    int line = previous().line;  // for
     consume(LEFT_PAREN, "Expected '(' after 'for'.");
     auto init = parseExpression();
     consume(SEMICOLON, "Expected ';' after for initializer.");
@@ -149,174 +128,167 @@ unique_ptr<Statement> Parser::parseForStatement() {
     consume(RIGHT_PAREN, "Expected ')' after for clauses.");
     auto body = parseBlock();
 
-    auto stmt = std::make_unique<ForStatement>();
-    stmt->init = std::move(init);
-    stmt->condition = std::move(condition);
-    stmt->increment = std::move(increment);
-    stmt->body = std::move(body);
-    return stmt;
+    return ast.add(ForStatement{init, condition, increment, body, line});
 }
 
 // { stmt* }
-unique_ptr<Statement> Parser::parseBlock() {
-    consume(LEFT_BRACE, "Expected '{'.");
-    auto block = std::make_unique<BlockStatement>();
+NodeId Parser::parseBlock() {
+    int line = consume(LEFT_BRACE, "Expected '{'.").line;
+    size_t mark = pending.size();
     while (!check(RIGHT_BRACE) && !isAtEnd()) {
-        block->statements.push_back(parseStatement());
+        NodeId stmt = parseStatement();
+        pending.push_back(stmt);
     }
     consume(RIGHT_BRACE, "Expected '}' after block.");
-    return block;
+
+    BlockStatement block;
+    block.first = static_cast<uint32_t>(ast.lists.size());
+    block.count = static_cast<uint32_t>(pending.size() - mark);
+    block.line = line;
+    ast.lists.insert(ast.lists.end(), pending.begin() + mark, pending.end());
+    pending.resize(mark);
+    return ast.add(block);
 }
 
 // expr;
-unique_ptr<Statement> Parser::parseExpressionStatement() {
+NodeId Parser::parseExpressionStatement() {
+    int line = peek().line;
     auto expr = parseExpression();
     consume(SEMICOLON, "Expected ';' after expression.");
-    auto stmt = std::make_unique<ExpressionStatement>();
-    stmt->expr = std::move(expr);
-    return stmt;
+    return ast.add(ExpressionStatement{expr, line});
 }
 
 
 
 // expression parsing is below this, i think
-unique_ptr<Expression> Parser::parsePrimary() {
+NodeId Parser::parsePrimary() {
      if(check(TokenType::NUMBER) || check(TokenType::STRING) 
         || check(TRUE) || check(FALSE) || check(NIL)){
-        auto literal = std::make_unique<LiteralExpression>();
-        literal->op = advance();
-        return literal;
+        return parseLiteral();
      }
      else if(check(TokenType::IDENTIFIER)){
-        auto identifier = std::make_unique<IdentifierExpression>();
-        identifier->name = advance();
-        return identifier;
+        IdentifierExpression identifier;
+        identifier.name = advance();
+        return ast.add(identifier);
      }
      else if (match(TokenType::LEFT_PAREN)){
         auto expr = parseExpression();
         consume(TokenType::RIGHT_PAREN, "Expect ')' after expression");
         return expr;
      }
-     throw std::runtime_error(
-        std::string("[line " + std::to_string(peek().line) + "] Unexpected token '" +
-        std::string(peek().lexeme) + "'.")
-     );
+     throw ScriptError("[line " + std::to_string(peek().line) + "] Unexpected token '" +
+        std::string(peek().lexeme) + "'.\n");
+}
+// literals are decoded here, once, so running them is just a constant load
+NodeId Parser::parseLiteral() {
+    Token token = advance();
+    switch (token.type) {
+        case NUMBER: {
+            int value = 0;
+            const char* first = token.lexeme.data();
+            const char* last = first + token.lexeme.size();
+            auto [end, ec] = std::from_chars(first, last, value);
+            if (ec == std::errc::result_out_of_range)
+                error(token, "Integer literal '" + std::string(token.lexeme) + "' is out of range.");
+            if (ec != std::errc() || end != last)
+                error(token, "Invalid integer literal '" + std::string(token.lexeme) + "'.");
+            return ast.addLiteral(token, value);
+        }
+        // the lexer already interned it without the quotes
+        case STRING: return ast.addLiteral(token, Value::interned(interner, token.symbol));
+        case TRUE:   return ast.addLiteral(token, true);
+        case FALSE:  return ast.addLiteral(token, false);
+        default:     return ast.addLiteral(token, Value());
+    }
 }
-unique_ptr<Expression> Parser::parseUnary(){
+NodeId Parser::parseUnary(){
     if(match(TokenType::MINUS) || match(TokenType::BANG)){
         Token unaryT = previous();
         auto right  = parseUnary();
-        auto UnaryExpr = std::make_unique<UnaryExpression>();
-        UnaryExpr->op = unaryT;
-        UnaryExpr->expr = std::move(right);
-        return UnaryExpr;
+        return ast.add(UnaryExpression{right, unaryT});
     } 
     return parsePrimary();
 }
-unique_ptr<Expression> Parser::parseMultiplication(){
+NodeId Parser::parseMultiplication(){
     auto expr = parseUnary();
     while(match(TokenType::SLASH) || match(TokenType::STAR)){
         Token op = previous();
         auto right = parseUnary();
 
-        auto bin = std::make_unique<BinaryExpression>();
-        bin->left = std::move(expr);
-        bin->op = op;
-        bin->right = std::move(right);
-        expr = std::move(bin);
+        expr = ast.add(BinaryExpression{expr, right, op});
     }
     return expr;
 }
-unique_ptr<Expression> Parser::parseAddition(){
+NodeId Parser::parseAddition(){
     auto expr = parseMultiplication();
     while(match(TokenType::MINUS) || match(TokenType::PLUS)){
         Token op = previous();
         auto right = parseMultiplication();
 
-        auto bin = std::make_unique<BinaryExpression>();
-        bin->left = std::move(expr);
-        bin->op = op;
-        bin->right = std::move(right);
-        expr = std::move(bin);
+        expr = ast.add(BinaryExpression{expr, right, op});
     }
     return expr;
 }
-unique_ptr<Expression> Parser::parseComparision(){
+NodeId Parser::parseComparision(){
     auto expr = parseAddition();
     while(match(TokenType::GREATER) || match(TokenType::GREATER_EQUAL) 
           || match(TokenType::LESS) || match(TokenType::LESS_EQUAL)){
           Token op = previous();
           auto right = parseAddition();
 
-          auto bin = std::make_unique<BinaryExpression>();
-          bin->left = std::move(expr);
-          bin->op = op;
-          bin->right = std::move(right);
-          expr = std::move(bin);
+          expr = ast.add(BinaryExpression{expr, right, op});
     }  
     return expr;
 }
-unique_ptr<Expression> Parser::parseEquality(){
+NodeId Parser::parseEquality(){
     auto expr = parseComparision();
     while(match(TokenType::EQUAL_EQUAL) || match(TokenType::BANG_EQUAL)){
         Token op = previous();
         auto right = parseComparision();
 
-        auto bin = std::make_unique<BinaryExpression>();
-        bin->left = std::move(expr);
-        bin->op = op;
-        bin->right = std::move(right);
-        expr = std::move(bin);
+        expr = ast.add(BinaryExpression{expr, right, op});
     }
     return expr;
 }
-unique_ptr<Expression> Parser::parseLogicalAnd(){
+NodeId Parser::parseLogicalAnd(){
     auto expr = parseEquality();
 
     while(match(TokenType::AND)){
         Token op = previous();
         auto right = parseEquality();
 
-        auto bin = std::make_unique<BinaryExpression>();
-        bin->left = std::move(expr);
-        bin->op = op;
-        bin->right = std::move(right);
-        expr = std::move(bin);
+        expr = ast.add(BinaryExpression{expr, right, op});
     }
     return expr;
 }
-unique_ptr<Expression> Parser::parseLogicalOr(){
+NodeId Parser::parseLogicalOr(){
     auto expr = parseLogicalAnd();
     
     while(match(TokenType::OR)){
         Token op = previous();
         auto right = parseLogicalAnd();
 
-        auto bin  = std::make_unique<BinaryExpression>();
-        bin->left = std::move(expr);
-        bin->op = op;
-        bin->right = std::move(right);
-        expr = std::move(bin);
+        expr = ast.add(BinaryExpression{expr, right, op});
     }
     return expr;
 }
-unique_ptr<Expression> Parser::parseExpression(){
+NodeId Parser::parseExpression(){
     return parseAssignment();
 }
-unique_ptr<Expression> Parser:: parseAssignment(){
+NodeId Parser:: parseAssignment(){
     auto expr = parseLogicalOr();
 
     if(match(TokenType::EQUAL)){
         Token eq = previous();
         auto value = parseAssignment();
         
-        if(auto* identifier = dynamic_cast<IdentifierExpression*>(expr.get())) {
-        auto assignment  = std::make_unique<AssignmentExpression>();
-        assignment->name =identifier->name;
-        assignment->value = std::move(value);
-        return assignment;
+        if(kindOf(expr) == NodeKind::Identifier) {
+        AssignmentExpression assignment;
+        assignment.name = ast.get<IdentifierExpression>(expr).name;
+        assignment.value = value;
+        return ast.add(assignment);
         }
-    throw std::runtime_error("Invalid Assignment");
+    error(eq, "Invalid Assignment");
        }
    return expr;
 }
@@ -0,0 +1,110 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+const char* kindName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Print:          return "display";
+        case NodeKind::VarDecl:        return "declare";
+        case NodeKind::Block:          return "block";
+        case NodeKind::If:             return "if";
+        case NodeKind::While:          return "while";
+        case NodeKind::For:            return "for";
+        case NodeKind::ExpressionStmt: return "expression";
+        default:                       return "?";
+    }
+}
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+Profiler::Profiler(const Ast& ast, std::string_view source) : ast(ast) {
+    statements[static_cast<size_t>(NodeKind::Print)].resize(ast.count<PrintStatement>());
+    statements[static_cast<size_t>(NodeKind::VarDecl)].resize(ast.count<VarDeclStatement>());
+    statements[static_cast<size_t>(NodeKind::Block)].resize(ast.count<BlockStatement>());
+    statements[static_cast<size_t>(NodeKind::If)].resize(ast.count<IfStatement>());
+    statements[static_cast<size_t>(NodeKind::While)].resize(ast.count<WhileStatement>());
+    statements[static_cast<size_t>(NodeKind::For)].resize(ast.count<ForStatement>());
+    statements[static_cast<size_t>(NodeKind::ExpressionStmt)].resize(ast.count<ExpressionStatement>());
+
+    size_t at = 0;
+    while (at <= source.size()) {
+        size_t newline = source.find('\n', at);
+        if (newline == std::string_view::npos) newline = source.size();
+        sourceLines.push_back(source.substr(at, newline - at));
+        at = newline + 1;
+    }
+    lines.resize(sourceLines.size() + 1);
+}
+
+void Profiler::report(std::ostream& out) const {
+    double total = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    char row[256];
+
+    struct Hot {
+        NodeId id;
+        Stats stats;
+    };
+    std::vector<Hot> hot;
+    uint64_t executed = 0;
+    for (size_t kind = 0; kind < KIND_COUNT; kind++) {
+        for (size_t i = 0; i < statements[kind].size(); i++) {
+            const Stats& s = statements[kind][i];
+            if (s.count == 0) continue;
+            executed += s.count;
+            hot.push_back({static_cast<NodeId>((kind << NODE_INDEX_BITS) | i), s});
+        }
+    }
+    std::sort(hot.begin(), hot.end(), [](const Hot& a, const Hot& b) {
+        return a.stats.nanos > b.stats.nanos;
+    });
+
+    std::snprintf(row, sizeof(row), "== profile: %.3f ms, %llu statements executed ==\n\n",
+                  total / 1e6, static_cast<unsigned long long>(executed));
+    out << row;
+
+    // blocks only ever repeat the time of the statement that owns them
+    out << "hot statements, by inclusive time\n";
+    std::snprintf(row, sizeof(row), "%6s  %-10s %12s %12s %10s %7s  %s\n",
+                  "line", "kind", "count", "total ms", "avg ns", "%", "source");
+    out << row;
+    size_t shown = 0;
+    for (const Hot& h : hot) {
+        if (kindOf(h.id) == NodeKind::Block) continue;
+        if (shown++ == 20) break;
+        int line = ast.lineOf(h.id);
+        std::string_view text = line > 0 && static_cast<size_t>(line) <= sourceLines.size()
+                              ? trim(sourceLines[line - 1]) : std::string_view();
+        if (text.size() > 60) text = text.substr(0, 60);
+        std::snprintf(row, sizeof(row), "%6d  %-10s %12llu %12.3f %10.0f %6.1f%%  %.*s\n",
+                      line, kindName(kindOf(h.id)), static_cast<unsigned long long>(h.stats.count),
+                      h.stats.nanos / 1e6, static_cast<double>(h.stats.nanos) / h.stats.count,
+                      total > 0 ? 100.0 * h.stats.nanos / total : 0.0,
+                      static_cast<int>(text.size()), text.data());
+        out << row;
+    }
+
+    out << "\nannotated source, inclusive time per line\n";
+    std::snprintf(row, sizeof(row), "%12s %12s %7s | %5s |\n", "count", "ms", "%", "line");
+    out << row;
+    for (size_t i = 0; i < sourceLines.size(); i++) {
+        const LineStats& l = lines[i + 1];
+        std::string_view text = sourceLines[i];
+        if (l.count == 0) {
+            std::snprintf(row, sizeof(row), "%12s %12s %7s | %5zu | ", "", "", "", i + 1);
+        } else {
+            std::snprintf(row, sizeof(row), "%12llu %12.3f %6.1f%% | %5zu | ",
+                          static_cast<unsigned long long>(l.count), l.nanos / 1e6,
+                          total > 0 ? 100.0 * l.nanos / total : 0.0, i + 1);
+        }
+        out << row << text << "\n";
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "interpreter/parser/ast.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// what --profile collects. the evaluator calls enter/exit around every
+// statement it executes and the profiler keeps a count and the inclusive
+// time (the statement plus everything it ran) for each statement and for
+// each source line. report() prints the hottest statements, then the
+// source with the numbers next to each line.
+//
+// a line only counts time once even when statements on it nest, so
+// while (...) { i = i + 1; } on one line isn't charged twice.
+class Profiler {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Profiler(const Ast& ast, std::string_view source);
+
+        void start() { began = Clock::now(); }
+        void stop() { elapsed += Clock::now() - began; }
+
+        Clock::time_point enter(NodeId stmt) {
+            int line = ast.lineOf(stmt);
+            if (static_cast<size_t>(line) < lines.size()) lines[line].active++;
+            return Clock::now();
+        }
+
+        void exit(NodeId stmt, Clock::time_point entered) {
+            auto spent = static_cast<uint64_t>((Clock::now() - entered).count());
+            Stats& s = statements[static_cast<size_t>(kindOf(stmt))][indexOf(stmt)];
+            s.count++;
+            s.nanos += spent;
+
+            int line = ast.lineOf(stmt);
+            if (static_cast<size_t>(line) >= lines.size()) return;
+            LineStats& l = lines[line];
+            // a block runs once per time its owner does, counting it would double up
+            if (kindOf(stmt) != NodeKind::Block) l.count++;
+            if (--l.active == 0) l.nanos += spent;
+        }
+
+        void report(std::ostream& out) const;
+
+    private:
+        struct Stats {
+            uint64_t count = 0;
+            uint64_t nanos = 0;
+        };
+        struct LineStats {
+            uint64_t count = 0;
+            uint64_t nanos = 0;
+            int active = 0; // statements on this line currently running
+        };
+
+        static constexpr size_t KIND_COUNT = static_cast<size_t>(NodeKind::ExpressionStmt) + 1;
+
+        const Ast& ast;
+        std::vector<std::string_view> sourceLines; // sourceLines[0] is line 1
+
+        // one entry per statement node, indexed by kind then pool index
+        std::array<std::vector<Stats>, KIND_COUNT> statements;
+        std::vector<LineStats> lines; // indexed by line number
+
+        Clock::time_point began;
+        Clock::duration elapsed{};
+};
+
+#endif
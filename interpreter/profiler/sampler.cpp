@@ -0,0 +1,277 @@
+#include "sampler.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+namespace {
+
+Sampler* active = nullptr;
+
+// cpu time used by the process, clock_gettime is safe inside a signal handler
+int64_t cpuNanos() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+const char* kindName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Print:          return "display";
+        case NodeKind::VarDecl:        return "declare";
+        case NodeKind::If:             return "if";
+        case NodeKind::While:          return "while";
+        case NodeKind::For:            return "for";
+        case NodeKind::ExpressionStmt: return "expression";
+        default:                       return "statement";
+    }
+}
+
+// just enough protobuf to write a profile: varints, and length delimited
+// fields built into their own buffer first
+class ProtoWriter {
+    public:
+        void varint(uint64_t v) {
+            while (v >= 0x80) {
+                bytes.push_back(static_cast<char>(v | 0x80));
+                v >>= 7;
+            }
+            bytes.push_back(static_cast<char>(v));
+        }
+        void tag(int field, int wireType) { varint(static_cast<uint64_t>(field) << 3 | wireType); }
+        void uintField(int field, uint64_t v) {
+            tag(field, 0);
+            varint(v);
+        }
+        void bytesField(int field, std::string_view data) {
+            tag(field, 2);
+            varint(data.size());
+            bytes.append(data.data(), data.size());
+        }
+        void messageField(int field, const ProtoWriter& message) { bytesField(field, message.bytes); }
+        void packedField(int field, const std::vector<uint64_t>& values) {
+            ProtoWriter packed;
+            for (uint64_t v : values) packed.varint(v);
+            bytesField(field, packed.bytes);
+        }
+
+        std::string bytes;
+};
+
+} // namespace
+
+// the buffer is left uninitialised, pages nobody samples into are never touched
+Sampler::Sampler(const Ast& ast, std::string_view source, std::string scriptName)
+    : ast(ast), scriptName(std::move(scriptName)), buffer(new uint32_t[BUFFER_WORDS]) {
+    size_t at = 0;
+    while (at <= source.size()) {
+        size_t newline = source.find('\n', at);
+        if (newline == std::string_view::npos) newline = source.size();
+        sourceLines.push_back(source.substr(at, newline - at));
+        at = newline + 1;
+    }
+}
+
+Sampler::~Sampler() {
+    if (active == this) stop();
+}
+
+void Sampler::onSignal(int) {
+    if (active) active->record();
+}
+
+void Sampler::record() {
+    uint32_t d = depth.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    if (d > MAX_DEPTH) d = MAX_DEPTH;
+    NodeId leaf = current.load(std::memory_order_relaxed);
+    int64_t now = cpuNanos();
+    int64_t spent = (now - lastCpuNanos) / 1000;
+    lastCpuNanos = now;
+    if (used + d + 3 > BUFFER_WORDS) {
+        dropped++;
+        return;
+    }
+    buffer[used] = static_cast<uint32_t>(spent > UINT32_MAX ? UINT32_MAX : spent);
+    std::memcpy(&buffer[used + 2], stack, d * sizeof(NodeId));
+    // the running statement is its own frame, unless it's the innermost if
+    // or loop itself (running its condition), or a block, which would only
+    // repeat its owner
+    if (leaf != NO_NODE && kindOf(leaf) != NodeKind::Block && (d == 0 || stack[d - 1] != leaf))
+        buffer[used + 2 + d++] = leaf;
+    buffer[used + 1] = d;
+    used += d + 2;
+    samples++;
+}
+
+bool Sampler::start(int rate) {
+#ifdef _WIN32
+    (void)rate;
+    std::cerr << "[ERROR] --sample-profile needs setitimer, which this platform doesn't have.\n";
+    return false;
+#else
+    if (rate <= 0 || rate > 1000000) {
+        std::cerr << "[ERROR] Sample rate must be between 1 and 1000000 hz.\n";
+        return false;
+    }
+    hz = rate;
+    active = this;
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+        std::cerr << "[ERROR] Could not install the SIGPROF handler.\n";
+        active = nullptr;
+        return false;
+    }
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = rate == 1 ? 1 : 0;
+    timer.it_interval.tv_usec = rate == 1 ? 0 : 1000000 / rate;
+    if (timer.it_interval.tv_sec == 0 && timer.it_interval.tv_usec == 0) timer.it_interval.tv_usec = 1;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        std::cerr << "[ERROR] Could not start the profiling timer.\n";
+        active = nullptr;
+        return false;
+    }
+
+    lastCpuNanos = cpuNanos();
+    startedNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return true;
+#endif
+}
+
+void Sampler::stop() {
+#ifndef _WIN32
+    struct itimerval off;
+    std::memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, nullptr);
+    signal(SIGPROF, SIG_IGN);
+    active = nullptr;
+
+    durationNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() - startedNanos;
+#endif
+}
+
+std::string Sampler::frameName(NodeId stmt) const {
+    int line = ast.lineOf(stmt);
+    std::string name = "line " + std::to_string(line) + ": ";
+    std::string_view text = line > 0 && static_cast<size_t>(line) <= sourceLines.size()
+                          ? sourceLines[line - 1] : std::string_view(kindName(kindOf(stmt)));
+    size_t first = text.find_first_not_of(" \t\r");
+    size_t last = text.find_last_not_of(" \t\r");
+    if (first != std::string_view::npos) text = text.substr(first, last - first + 1);
+    if (text.size() > 80) text = text.substr(0, 80);
+    // ; separates frames in the folded format
+    for (char c : text) {
+        if (c != ';') name += c;
+    }
+    return name;
+}
+
+void Sampler::writeFolded(std::ostream& out) const {
+    // same stack, same line, counts added up
+    std::map<std::string, uint64_t> stacks;
+    std::unordered_map<NodeId, std::string> names;
+    for (size_t at = 0; at < used;) {
+        uint32_t d = buffer[at + 1];
+        std::string key = scriptName;
+        for (uint32_t i = 0; i < d; i++) {
+            NodeId id = buffer[at + 2 + i];
+            auto it = names.find(id);
+            if (it == names.end()) it = names.emplace(id, frameName(id)).first;
+            key += ';';
+            key += it->second;
+        }
+        stacks[key]++;
+        at += d + 2;
+    }
+    for (const auto& [stack, count] : stacks) out << stack << ' ' << count << '\n';
+}
+
+void Sampler::writePprof(std::ostream& out) const {
+    std::vector<std::string> strings = {""};
+    auto intern = [&strings](const std::string& s) {
+        strings.push_back(s);
+        return static_cast<uint64_t>(strings.size() - 1);
+    };
+    uint64_t samplesName = intern("samples"), countUnit = intern("count");
+    uint64_t cpuName = intern("cpu"), nanosUnit = intern("nanoseconds");
+    uint64_t fileName = intern(scriptName);
+    int64_t period = 1000000000LL / hz;
+
+    // one function and one location per statement that showed up, ids from 1
+    std::unordered_map<NodeId, uint64_t> locationOf;
+    ProtoWriter profile;
+    auto valueType = [](uint64_t type, uint64_t unit) {
+        ProtoWriter vt;
+        vt.uintField(1, type);
+        vt.uintField(2, unit);
+        return vt;
+    };
+    profile.messageField(1, valueType(samplesName, countUnit));
+    profile.messageField(1, valueType(cpuName, nanosUnit));
+
+    std::vector<NodeId> order;
+    for (size_t at = 0; at < used;) {
+        uint64_t spent = static_cast<uint64_t>(buffer[at]) * 1000;
+        uint32_t d = buffer[at + 1];
+        std::vector<uint64_t> locations;
+        // pprof wants the leaf first
+        for (uint32_t i = d; i >= 1; i--) {
+            NodeId id = buffer[at + 1 + i];
+            auto [it, added] = locationOf.emplace(id, locationOf.size() + 1);
+            if (added) order.push_back(id);
+            locations.push_back(it->second);
+        }
+        ProtoWriter sample;
+        sample.packedField(1, locations);
+        sample.packedField(2, {1, spent});
+        profile.messageField(2, sample);
+        at += d + 2;
+    }
+
+    for (NodeId id : order) {
+        uint64_t ref = locationOf[id];
+        ProtoWriter line;
+        line.uintField(1, ref);
+        line.uintField(2, static_cast<uint64_t>(ast.lineOf(id)));
+        ProtoWriter location;
+        location.uintField(1, ref);
+        location.messageField(4, line);
+        profile.messageField(4, location);
+    }
+    for (NodeId id : order) {
+        ProtoWriter function;
+        function.uintField(1, locationOf[id]);
+        function.uintField(2, intern(frameName(id)));
+        function.uintField(4, fileName);
+        function.uintField(5, static_cast<uint64_t>(ast.lineOf(id)));
+        profile.messageField(5, function);
+    }
+
+    for (const std::string& s : strings) profile.bytesField(6, s);
+    profile.uintField(9, static_cast<uint64_t>(startedNanos));
+    profile.uintField(10, static_cast<uint64_t>(durationNanos));
+    profile.messageField(11, valueType(cpuName, nanosUnit));
+    profile.uintField(12, static_cast<uint64_t>(period));
+
+    out.write(profile.bytes.data(), static_cast<std::streamsize>(profile.bytes.size()));
+}
@@ -0,0 +1,92 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "interpreter/parser/ast.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// what --sample-profile collects. the evaluator stores the statement it's
+// running in one slot (a single store per statement), and pushes a frame
+// only when it enters an if, while or for, which the statements it runs
+// nest under. a SIGPROF timer copies the frames and the slot into a
+// preallocated buffer hz times a second of cpu time. nothing is timed per
+// statement, so tight loops run at close to full speed, unlike --profile.
+//
+// the handler only reads the stack and writes into the buffer, it never
+// allocates or locks. only one sampler can run at a time, the signal is
+// process wide. not available on windows.
+class Sampler {
+    public:
+        static constexpr uint32_t MAX_DEPTH = 128;   // deeper frames are cut off
+        static constexpr size_t BUFFER_WORDS = 1 << 22; // 16MB of samples
+
+        Sampler(const Ast& ast, std::string_view source, std::string scriptName);
+        ~Sampler();
+
+        // prints an error and returns false if the timer can't be set up
+        bool start(int hz);
+        void stop();
+
+        // the statement running now
+        void at(NodeId stmt) { current.store(stmt, std::memory_order_relaxed); }
+
+        // around an if, while or for, once however many times it loops
+        void push(NodeId stmt) {
+            uint32_t d = depth.load(std::memory_order_relaxed);
+            if (d < MAX_DEPTH) stack[d] = stmt;
+            // the handler must never see the new depth before the new frame
+            std::atomic_signal_fence(std::memory_order_release);
+            depth.store(d + 1, std::memory_order_relaxed);
+        }
+        // the if or loop is what's running until the next statement starts,
+        // not the last statement it ran
+        void pop() {
+            uint32_t d = depth.load(std::memory_order_relaxed) - 1;
+            if (d < MAX_DEPTH) current.store(stack[d], std::memory_order_relaxed);
+            depth.store(d, std::memory_order_relaxed);
+        }
+
+        // brendan gregg's folded format, one "frame;frame;frame count" per stack
+        void writeFolded(std::ostream& out) const;
+        // pprof's profile.proto, uncompressed (pprof reads it either way)
+        void writePprof(std::ostream& out) const;
+
+        size_t sampleCount() const { return samples; }
+        size_t droppedCount() const { return dropped; }
+
+    private:
+        const Ast& ast;
+        std::vector<std::string_view> sourceLines;
+        std::string scriptName;
+        int hz = 0;
+        int64_t startedNanos = 0;
+        int64_t durationNanos = 0;
+        int64_t lastCpuNanos = 0;
+
+        // the ifs and loops the evaluator is inside, outermost first, and
+        // the statement it's running in them
+        NodeId stack[MAX_DEPTH] = {};
+        std::atomic<uint32_t> depth{0};
+        std::atomic<NodeId> current{NO_NODE};
+
+        // samples back to back: [cpu us since the last one, depth,
+        // outermost id, ..., innermost id]. the timer only fires on a
+        // kernel tick, so the real gap can be longer than 1/hz
+        std::unique_ptr<uint32_t[]> buffer;
+        size_t used = 0;
+        size_t samples = 0;
+        size_t dropped = 0; // buffer was full
+
+        static void onSignal(int);
+        void record();
+
+        // folded stack / pprof name for a statement
+        std::string frameName(NodeId stmt) const;
+};
+
+#endif
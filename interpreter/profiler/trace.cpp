@@ -0,0 +1,61 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20) out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+bool Tracer::write(const std::string& path, const Ast& ast, std::string_view source) const {
+    std::vector<std::string_view> lines;
+    size_t at = 0;
+    while (at <= source.size()) {
+        size_t newline = source.find('\n', at);
+        if (newline == std::string_view::npos) newline = source.size();
+        lines.push_back(source.substr(at, newline - at));
+        at = newline + 1;
+    }
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char numbers[128];
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& e = events[i];
+        json += i ? ",\n{\"name\":" : "{\"name\":";
+        if (e.statement < 0) {
+            appendJsonString(json, e.name);
+            json += ",\"cat\":\"phase\",\"tid\":1";
+        } else {
+            int line = ast.lineOf(ast.statements[static_cast<size_t>(e.statement)]);
+            std::string_view text = line > 0 && static_cast<size_t>(line) <= lines.size()
+                                  ? lines[line - 1] : std::string_view();
+            size_t first = text.find_first_not_of(" \t\r");
+            text = first == std::string_view::npos ? std::string_view() : text.substr(first, 80);
+            appendJsonString(json, "line " + std::to_string(line) + ": " + std::string(text));
+            std::snprintf(numbers, sizeof(numbers), ",\"cat\":\"statement\",\"tid\":2,\"args\":{\"line\":%d}", line);
+            json += numbers;
+        }
+        std::snprintf(numbers, sizeof(numbers), ",\"ph\":\"X\",\"pid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                      e.start, e.end - e.start);
+        json += numbers;
+    }
+    json += "\n]}\n";
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out << json;
+    return static_cast<bool>(out);
+}
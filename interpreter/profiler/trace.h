@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "interpreter/parser/ast.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// collects what --trace writes: one complete event per pipeline phase and
+// one per top level statement, saved as chrome trace event json (load it in
+// chrome://tracing or perfetto).
+//
+// statements are reported by index into ast.statements. whichever engine
+// runs calls mark(i) as statement i starts, which also ends the one before.
+class Tracer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Tracer() : origin(Clock::now()) {}
+
+        void phase(const char* name, Clock::time_point start, Clock::time_point end) {
+            events.push_back({name, -1, micros(start), micros(end)});
+        }
+
+        void mark(uint32_t statement) {
+            auto now = Clock::now();
+            endMarks(now);
+            openStatement = static_cast<int64_t>(statement);
+            openedAt = now;
+        }
+        void endMarks() { endMarks(Clock::now()); }
+
+        // names statements after their source line
+        bool write(const std::string& path, const Ast& ast, std::string_view source) const;
+
+    private:
+        struct Event {
+            const char* name; // phases only
+            int64_t statement; // -1 for phases
+            double start;      // microseconds since origin
+            double end;
+        };
+
+        Clock::time_point origin;
+        std::vector<Event> events;
+        int64_t openStatement = -1;
+        Clock::time_point openedAt;
+
+        double micros(Clock::time_point t) const {
+            return std::chrono::duration<double, std::micro>(t - origin).count();
+        }
+        void endMarks(Clock::time_point now) {
+            if (openStatement >= 0) events.push_back({nullptr, openStatement, micros(openedAt), micros(now)});
+            openStatement = -1;
+        }
+};
+
+#endif
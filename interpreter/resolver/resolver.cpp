@@ -0,0 +1,146 @@
+#include "resolver.h"
+#include "interpreter/error.h"
+#include <string>
+
+int Resolver::resolve(Ast& program, const std::vector<Symbol>& predeclared) {
+    ast = &program;
+    scopes.emplace_back();
+    for (Symbol name : predeclared)
+        scopes.back().try_emplace(name, static_cast<int>(scopes.back().size()));
+    for (NodeId stmt : program.statements) {
+        resolveStatement(stmt);
+    }
+
+    // report everything we found, then bail before running anything
+    if (!errors.empty()) throw ScriptError(errors);
+
+    int globals = static_cast<int>(scopes.back().size());
+    scopes.pop_back();
+    return globals;
+}
+
+// statements
+
+void Resolver::resolveStatement(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Print:
+            resolveExpression(ast->get<PrintStatement>(id).expr);
+            return;
+
+        case NodeKind::VarDecl: {
+            auto& s = ast->get<VarDeclStatement>(id);
+            // initialiser first, int x = x; reads the outer x (or nothing)
+            resolveExpression(s.initialiser);
+            declare(s);
+            return;
+        }
+
+        case NodeKind::Block: {
+            auto& s = ast->get<BlockStatement>(id);
+            scopes.emplace_back();
+            for (const NodeId* it = ast->begin(s); it != ast->end(s); ++it) {
+                resolveStatement(*it);
+            }
+            s.slotCount = static_cast<int>(scopes.back().size());
+            scopes.pop_back();
+            return;
+        }
+
+        case NodeKind::If: {
+            const auto& s = ast->get<IfStatement>(id);
+            resolveExpression(s.condition);
+            resolveStatement(s.thenBranch);
+            if (s.elseBranch != NO_NODE) resolveStatement(s.elseBranch);
+            return;
+        }
+
+        case NodeKind::While: {
+            const auto& s = ast->get<WhileStatement>(id);
+            resolveExpression(s.condition);
+            resolveStatement(s.body);
+            return;
+        }
+
+        case NodeKind::For: {
+            const auto& s = ast->get<ForStatement>(id);
+            resolveExpression(s.init);
+            resolveExpression(s.condition);
+            resolveExpression(s.increment);
+            resolveStatement(s.body);
+            return;
+        }
+
+        case NodeKind::ExpressionStmt:
+            resolveExpression(ast->get<ExpressionStatement>(id).expr);
+            return;
+
+        default:
+            return;
+    }
+}
+
+// expressions
+
+void Resolver::resolveExpression(NodeId id) {
+    switch (kindOf(id)) {
+        case NodeKind::Identifier: {
+            auto& e = ast->get<IdentifierExpression>(id);
+            if (!lookup(e.name, e.depth, e.slot))
+                error(e.name, "Undefined variable");
+            return;
+        }
+
+        case NodeKind::Assignment: {
+            resolveExpression(ast->get<AssignmentExpression>(id).value);
+            auto& e = ast->get<AssignmentExpression>(id);
+            if (!lookup(e.name, e.depth, e.slot))
+                error(e.name, "Undefined variable");
+            return;
+        }
+
+        case NodeKind::Unary:
+            resolveExpression(ast->get<UnaryExpression>(id).expr);
+            return;
+
+        case NodeKind::Binary: {
+            const auto& e = ast->get<BinaryExpression>(id);
+            resolveExpression(e.left);
+            resolveExpression(e.right);
+            return;
+        }
+
+        // literals have nothing to resolve
+        default:
+            return;
+    }
+}
+
+// scopes
+
+void Resolver::declare(VarDeclStatement& decl) {
+    auto& scope = scopes.back();
+    int slot = static_cast<int>(scope.size());
+    if (!scope.try_emplace(decl.name.symbol, slot).second) {
+        error(decl.name, "Redeclaration of variable");
+        return;
+    }
+    decl.slot = slot;
+}
+
+bool Resolver::lookup(const Token& name, int& depth, int& slot) {
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; i--) {
+        auto it = scopes[i].find(name.symbol);
+        if (it != scopes[i].end()) {
+            depth = static_cast<int>(scopes.size()) - 1 - i;
+            slot = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Resolver::error(const Token& name, const char* message) {
+    errors += "[line " + std::to_string(name.line) + "] ERROR: " + message + " '";
+    errors += name.lexeme;
+    errors += "'.\n";
+}
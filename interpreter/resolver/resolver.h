@@ -0,0 +1,34 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "interpreter/parser/ast.h"
+#include <unordered_map>
+#include <vector>
+
+// runs between the parser and the evaluator. every variable use gets a
+// (depth, slot) pair so nothing has to look names up at runtime, and
+// undefined or redeclared variables are reported before anything executes.
+class Resolver {
+    public:
+        // returns how many slots the top level scope needs. predeclared
+        // names take the first top level slots, in order, for variables an
+        // embedding program fills in before running (zenith.h)
+        int resolve(Ast& ast, const std::vector<Symbol>& predeclared = {});
+
+    private:
+        Ast* ast = nullptr;
+        // innermost scope is at the back, name symbol -> slot
+        std::vector<std::unordered_map<Symbol, int>> scopes;
+        // every error found, reported together at the end
+        std::string errors;
+
+        void resolveStatement(NodeId stmt);
+        void resolveExpression(NodeId expr);
+
+        void declare(VarDeclStatement& decl);
+        bool lookup(const Token& name, int& depth, int& slot);
+
+        void error(const Token& name, const char* message);
+};
+
+#endif
@@ -0,0 +1,421 @@
+#include "server.h"
+#include "zenith.h"
+#include "interpreter/source.h"
+#include "interpreter/output.h"
+#include "interpreter/error.h"
+#include "interpreter/cache/cache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SIGPIPE is ignored instead
+#endif
+
+namespace {
+
+// requests bigger than this are refused rather than buffered
+constexpr uint32_t MAX_REQUEST = 1u << 30;
+// compiled programs kept around, weighed by the size of their source (what
+// the bytecode and constants grow with). least recently used goes first
+constexpr size_t CACHED_BYTES = 256u << 20;
+// a client that sends nothing, or stops taking its output, for this long
+// is given up on
+constexpr int IO_SECONDS = 10;
+// how often running requests are looked in on
+constexpr int WATCH_MS = 100;
+
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sendMessage(int fd, char type, std::string_view payload) {
+    char header[5] = {type};
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    for (int i = 0; i < 4; i++) header[1 + i] = static_cast<char>(size >> (8 * i));
+    return sendAll(fd, header, sizeof(header)) && sendAll(fd, payload.data(), payload.size());
+}
+
+bool readMessage(int fd, char& type, std::string& payload) {
+    unsigned char header[5];
+    if (!readAll(fd, reinterpret_cast<char*>(header), sizeof(header))) return false;
+    type = static_cast<char>(header[0]);
+    uint32_t size = 0;
+    for (int i = 0; i < 4; i++) size |= static_cast<uint32_t>(header[1 + i]) << (8 * i);
+    if (size > MAX_REQUEST) return false;
+    payload.resize(size);
+    return readAll(fd, payload.data(), size);
+}
+
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "[ERROR] Socket path too long: '" << path << "'\n";
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool hasZenExtension(const std::string& path) {
+    return path.length() > 4 && path.substr(path.length() - 4) == ".zen";
+}
+
+// compiled programs by a 128 bit hash of their source, so the text itself
+// isn't kept. the seed is new every run, nobody outside can line up two
+// scripts to collide. a Program is immutable, so workers share them without
+// copying and run them outside the lock
+class ProgramMemo {
+    public:
+        ProgramMemo() : seed(std::random_device()()) {}
+
+        zenith::Program get(std::string_view source) {
+            Key key;
+            key.first = hashBytes(source.data(), source.size(), seed);
+            key.second = hashBytes(source.data(), source.size(), key.first);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                auto it = index.find(key);
+                if (it != index.end()) {
+                    entries.splice(entries.begin(), entries, it->second);
+                    return it->second->program;
+                }
+            }
+            // two workers can both miss on the same script and compile it
+            // twice, the second one just finds it already there
+            zenith::Program program = zenith::compile(source);
+            if (source.size() > CACHED_BYTES) return program;
+            std::lock_guard<std::mutex> guard(lock);
+            if (index.find(key) == index.end()) {
+                entries.push_front({key, source.size(), program});
+                index.emplace(key, entries.begin());
+                bytes += source.size();
+                while (bytes > CACHED_BYTES) {
+                    bytes -= entries.back().size;
+                    index.erase(entries.back().key);
+                    entries.pop_back();
+                }
+            }
+            return program;
+        }
+
+    private:
+        using Key = std::pair<uint64_t, uint64_t>;
+        struct KeyHash {
+            size_t operator()(const Key& key) const { return static_cast<size_t>(key.first); }
+        };
+        struct Entry {
+            Key key;
+            size_t size;    // of the source
+            zenith::Program program;
+        };
+
+        uint64_t seed;
+        std::mutex lock;
+        // most recently used at the front
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t bytes = 0;
+};
+
+// a script that's running, and the flag that stops it (Context::interruptOn)
+struct Running {
+    int fd;
+    uint64_t id;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> stop{false};
+    bool timedOut = false;
+};
+
+// one thread looks in on every running script, and stops the ones whose
+// client has hung up or that have gone past the time limit. otherwise a
+// script that never ends holds on to its worker for good
+class Watchdog {
+    public:
+        // seconds = 0 is no time limit
+        explicit Watchdog(unsigned seconds) : seconds(seconds) {}
+
+        void add(Running& r) {
+            std::lock_guard<std::mutex> guard(lock);
+            r.id = nextId++;
+            r.deadline = seconds ? std::chrono::steady_clock::now() + std::chrono::seconds(seconds)
+                                 : std::chrono::steady_clock::time_point::max();
+            running.push_back(&r);
+            busy.notify_one();
+        }
+        void remove(Running& r) {
+            std::lock_guard<std::mutex> guard(lock);
+            running.erase(std::find(running.begin(), running.end(), &r));
+        }
+
+        [[noreturn]] void watch() {
+            std::vector<pollfd> fds;
+            std::vector<uint64_t> ids;
+            for (;;) {
+                fds.clear();
+                ids.clear();
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    busy.wait(guard, [&] { return !running.empty(); });
+                    for (const Running* r : running) {
+                        fds.push_back({r->fd, 0, 0}); // hangups are always reported
+                        ids.push_back(r->id);
+                    }
+                }
+                poll(fds.data(), fds.size(), WATCH_MS);
+
+                // only stop the ones still running, anything finished since
+                // may be gone and its fd reused
+                auto now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> guard(lock);
+                for (Running* r : running) {
+                    size_t i = std::find(ids.begin(), ids.end(), r->id) - ids.begin();
+                    bool hungUp = i < ids.size() && (fds[i].revents & (POLLHUP | POLLERR));
+                    if (now >= r->deadline) r->timedOut = true;
+                    if (hungUp || r->timedOut) r->stop.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        unsigned seconds;
+        std::mutex lock;
+        std::condition_variable busy;
+        std::vector<Running*> running;
+        uint64_t nextId = 0;
+};
+
+void handle(int fd, ProgramMemo& programs, Watchdog& watchdog) {
+    char type;
+    std::string request;
+    if (!readMessage(fd, type, request) || (type != 'P' && type != 'S')) return;
+
+    // a path is read here, mapped like any other script. the client checks
+    // the extension too, but anything can connect
+    Source source;
+    std::string_view text = request;
+    if (type == 'P') {
+        if (!hasZenExtension(request)) {
+            sendMessage(fd, 'E', "[ERROR] File must have a .zen extension: '" + request + "'\n");
+            sendMessage(fd, 'X', "\1");
+            return;
+        }
+        try {
+            readFile(request, source);
+        } catch (const ScriptError& e) {
+            sendMessage(fd, 'E', e.what());
+            sendMessage(fd, 'X', "\1");
+            return;
+        }
+        text = source.text();
+    }
+    // same as running it directly, an empty script is a failure
+    if (text.empty()) {
+        sendMessage(fd, 'X', "\1");
+        return;
+    }
+
+    zenith::Program program = programs.get(text);
+    Running running;
+    running.fd = fd;
+    zenith::Context context;
+    // a client that's gone, or stopped reading, has no use for the rest
+    context.onOutput([&running](std::string_view chunk) {
+        if (!running.stop.load(std::memory_order_relaxed) && !sendMessage(running.fd, 'O', chunk))
+            running.stop.store(true, std::memory_order_relaxed);
+    });
+    context.interruptOn(&running.stop);
+    watchdog.add(running);
+    zenith::Result result = zenith::run(program, context);
+    watchdog.remove(running);
+
+    if (!result.ok && running.timedOut) {
+        sendMessage(fd, 'E', "[ERROR] Script ran past the server's time limit and was stopped.\n");
+    } else if (!result.ok) {
+        sendMessage(fd, 'E', result.error);
+    }
+    sendMessage(fd, 'X', result.ok ? std::string_view("\0", 1) : "\1");
+}
+
+// the socket to remove on the way out. signal handlers can only see globals,
+// and there's one server per process
+char listeningPath[sizeof(sockaddr_un::sun_path)];
+
+extern "C" void stopServing(int) {
+    unlink(listeningPath);
+    _exit(0);
+}
+
+} // namespace
+
+int serve(const std::string& socketPath, unsigned workers, unsigned timeLimit) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return 1;
+
+    // a socket left behind by a server that died is in the way of bind
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) unlink(socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "[ERROR] Could not listen on '" << socketPath << "'\n";
+        return 1;
+    }
+    std::memcpy(listeningPath, address.sun_path, sizeof(listeningPath));
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    // a client that hangs up early shouldn't take the server with it
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    ProgramMemo programs;
+    Watchdog watchdog(timeLimit);
+    std::thread([&] { watchdog.watch(); }).detach();
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<int> waiting;
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < workers; i++) {
+        pool.emplace_back([&] {
+            for (;;) {
+                int fd;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    ready.wait(guard, [&] { return !waiting.empty(); });
+                    fd = waiting.front();
+                    waiting.pop_front();
+                }
+                handle(fd, programs, watchdog);
+                close(fd);
+            }
+        });
+    }
+
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "[ERROR] Could not accept a connection on '" << socketPath << "'\n";
+            unlink(listeningPath);
+            std::_Exit(1); // the workers never return, there's nothing to join
+        }
+        // a client that connects and then says nothing, or never reads
+        // what it's sent, can't hold a worker for longer than this
+        timeval limit = {IO_SECONDS, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+        std::lock_guard<std::mutex> guard(lock);
+        waiting.push_back(fd);
+        ready.notify_one();
+    }
+}
+
+int runClient(const std::string& socketPath, const std::string& path) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return 1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "[ERROR] Could not connect to '" << socketPath << "'\n";
+        return 1;
+    }
+
+    bool sent;
+    if (path == "-") {
+        // the server can't read our stdin, so the text goes instead
+        Source source;
+        try {
+            source.load(path);
+        } catch (const ScriptError& e) {
+            std::cerr << e.what();
+            return 1;
+        }
+        sent = sendMessage(fd, 'S', source.text());
+    } else {
+        // caught here so the message names the file the way it was given
+        if (!hasZenExtension(path)) {
+            std::cerr << "[ERROR] File must have a .zen extension: '" << path << "'\n";
+            return 1;
+        }
+        // the server's working directory isn't ours
+        std::string absolute = path;
+        char cwd[PATH_MAX];
+        if (path[0] != '/' && getcwd(cwd, sizeof(cwd))) absolute = std::string(cwd) + "/" + path;
+        sent = sendMessage(fd, 'P', absolute);
+    }
+
+    char type;
+    std::string payload;
+    while (sent && readMessage(fd, type, payload)) {
+        if (type == 'O') {
+            standardOutput().write(payload);
+        } else if (type == 'E') {
+            standardOutput().flush();
+            std::cerr << payload;
+        } else if (type == 'X' && payload.size() == 1) {
+            standardOutput().flush();
+            close(fd);
+            return payload[0];
+        }
+    }
+    standardOutput().flush();
+    std::cerr << "[ERROR] Lost the connection to '" << socketPath << "'\n";
+    close(fd);
+    return 1;
+}
+
+#else
+
+int serve(const std::string&, unsigned, unsigned) {
+    std::cerr << "[ERROR] --serve needs unix sockets, which this platform doesn't have.\n";
+    return 1;
+}
+
+int runClient(const std::string&, const std::string&) {
+    std::cerr << "[ERROR] --client needs unix sockets, which this platform doesn't have.\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+// --serve and --client: a resident interpreter on a unix socket, for
+// callers that would otherwise start a fresh zenith for every script.
+//
+// the server keeps a pool of worker threads and the compiled programs of
+// the scripts it has seen lately (keyed by a hash of the source, so an
+// edited file is a new entry), so a repeated script skips straight to
+// running. each connection carries one request:
+//
+//   client -> server   'P' absolute path to a script, or 'S' the source itself
+//   server -> client   any number of 'O' (stdout) and 'E' (stderr) chunks,
+//                      then 'X' with the exit status, then it hangs up
+//
+// every message is a type byte, a 4 byte little endian length, and that
+// many bytes. scripts run on the vm through libzenith (zenith.h), a script
+// error goes back to its own client and the server carries on.
+//
+// a script whose client hangs up, or stops reading, is stopped at its next
+// trip round a loop, and so is one that runs past the time limit. a client
+// that connects and sends nothing is dropped after a few seconds. none of
+// them keeps a worker for long.
+//
+// not available on windows.
+
+// runs until SIGINT or SIGTERM, which remove the socket. workers = 0 means
+// one per core, timeLimit is in seconds and 0 means none
+int serve(const std::string& socketPath, unsigned workers, unsigned timeLimit = 0);
+
+// sends path ("-" sends stdin's text instead) and relays the answer to
+// stdout and stderr. returns the script's exit status
+int runClient(const std::string& socketPath, const std::string& path);
+
+#endif
@@ -0,0 +1,78 @@
+#include "source.h"
+#include "error.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#define close _close
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+Source::~Source() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, mappingSize);
+#endif
+}
+
+void Source::load(const std::string& path) {
+    if (path == "-") return readStream(0, "<stdin>");
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw ScriptError("[ERROR] Could not open file '" + path + "'\n");
+
+    // closed on the way out, error or not
+    struct Closer {
+        int fd;
+        ~Closer() { close(fd); }
+    } closer{fd};
+#ifndef _WIN32
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        mappingSize = static_cast<size_t>(info.st_size);
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            mappingSize = 0;
+            readStream(fd, path);
+        } else {
+            // the lexer reads it front to back exactly once
+            madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+            view = std::string_view(static_cast<const char*>(mapping), mappingSize);
+        }
+    } else {
+        readStream(fd, path);
+    }
+#else
+    readStream(fd, path);
+#endif
+}
+
+void Source::readStream(int fd, const std::string& path) {
+    size_t used = 0;
+    buffer.resize(64 * 1024);
+    while (true) {
+        if (used == buffer.size()) buffer.resize(buffer.size() * 2);
+        auto got = read(fd, buffer.data() + used, static_cast<unsigned>(buffer.size() - used));
+        if (got == 0) break;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw ScriptError("[ERROR] Could not read '" + path + "'\n");
+        }
+        used += static_cast<size_t>(got);
+    }
+    buffer.resize(used);
+    view = buffer;
+}
+
+void readFile(const std::string& path, Source& source) {
+    // - reads the script from stdin
+    if (path != "-" && (path.length() <= 4 || path.substr(path.length() - 4) != ".zen"))
+        throw ScriptError("[ERROR] File must have a .zen extension: '" + path + "'\n");
+    source.load(path);
+}
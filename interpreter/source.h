@@ -0,0 +1,38 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <string>
+#include <string_view>
+
+// the text of a script. regular files get mapped straight into memory so
+// the bytes are never copied, the lexer's tokens point into the mapping.
+// pipes and stdin can't be mapped, so they're read into a string instead.
+//
+// keep it alive as long as anything holds a token.
+class Source {
+    public:
+        Source() = default;
+        ~Source();
+
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        // "-" means stdin. throws ScriptError if it can't be read
+        void load(const std::string& path);
+
+        std::string_view text() const { return view; }
+
+    private:
+        std::string_view view;
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+        std::string buffer; // the fallback when there's nothing to map
+
+        void readStream(int fd, const std::string& path);
+};
+
+// Source::load for a script named on the command line, which has to end in
+// .zen (or be -)
+void readFile(const std::string& path, Source& source);
+
+#endif
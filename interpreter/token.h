@@ -3,6 +3,7 @@
 
 
 #include <string>
+#include "interpreter/interner.h"
 
 enum TokenType {
     // single characters
@@ -38,6 +39,8 @@ struct Token {
     TokenType type;
     std::string_view lexeme;
     int line;
+    // identifiers and strings (without the quotes) are interned by the lexer
+    Symbol symbol = NO_SYMBOL;
 };
 
 
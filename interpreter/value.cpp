@@ -0,0 +1,159 @@
+#include "value.h"
+#include "output.h"
+#include "error.h"
+#include <algorithm>
+#include <new>
+
+// values
+
+Value Value::interned(const Interner& interner, Symbol symbol) {
+    return interned(symbol, interner.text(symbol).data());
+}
+
+Value Value::interned(Symbol symbol, const char* text) {
+    Value v;
+    v.bytes[0] = STR_INTERNED;
+    v.put(4, symbol);
+    v.put(8, text);
+    return v;
+}
+
+Value Value::string(std::string_view text) {
+    Value v;
+    if (text.size() <= SMALL_MAX) {
+        v.bytes[0] = STR_SMALL;
+        v.bytes[1] = static_cast<unsigned char>(text.size());
+        std::memcpy(v.bytes + 2, text.data(), text.size());
+        return v;
+    }
+
+    StrBuf* buf = allocate(static_cast<uint32_t>(text.size()));
+    std::memcpy(buf->data(), text.data(), text.size());
+    buf->used = static_cast<uint32_t>(text.size());
+    return heapString(buf, buf->used);
+}
+
+namespace {
+thread_local StringStats counts;
+}
+
+const StringStats& stringStats() {
+    return counts;
+}
+
+StrBuf* Value::allocate(uint32_t capacity) {
+    counts.buffers++;
+    counts.bytes += sizeof(StrBuf) + capacity;
+    auto* buf = static_cast<StrBuf*>(::operator new(sizeof(StrBuf) + capacity));
+    buf->refs = 0;
+    buf->used = 0;
+    buf->capacity = capacity;
+    buf->unused = 0;
+    return buf;
+}
+
+// takes a reference on buf
+Value Value::heapString(StrBuf* buf, uint32_t length) {
+    Value v;
+    buf->refs++;
+    v.bytes[0] = STR_HEAP;
+    v.put(4, length);
+    v.put(8, buf);
+    return v;
+}
+
+std::string_view Value::asString() const {
+    switch (bytes[0]) {
+        case STR_SMALL:
+            return std::string_view(reinterpret_cast<const char*>(bytes + 2), bytes[1]);
+        case STR_INTERNED: {
+            // the interner keeps each text's length just in front of it
+            const char* text = get<const char*>(8);
+            uint32_t length;
+            std::memcpy(&length, text - sizeof(uint32_t), sizeof(length));
+            return std::string_view(text, length);
+        }
+        case STR_HEAP:
+            return std::string_view(heap()->data(), get<uint32_t>(4));
+        default:
+            return std::string_view();
+    }
+}
+
+void Value::freeHeap() {
+    ::operator delete(heap());
+}
+
+bool operator==(const Value& a, const Value& b) {
+    if (a.isString() && b.isString()) {
+        // two interned strings are equal exactly when their symbols are
+        if (a.bytes[0] == Value::STR_INTERNED && b.bytes[0] == Value::STR_INTERNED)
+            return a.get<uint32_t>(4) == b.get<uint32_t>(4);
+        return a.asString() == b.asString();
+    }
+    if (a.bytes[0] != b.bytes[0]) return false;
+    switch (a.bytes[0]) {
+        case Value::INT:  return a.asInt() == b.asInt();
+        case Value::BOOL: return a.asBool() == b.asBool();
+        case Value::CHAR: return a.asChar() == b.asChar();
+        default:          return true; // null
+    }
+}
+
+Value concat(const Value& a, const Value& b) {
+    std::string_view left = a.asString();
+    std::string_view right = b.asString();
+    uint64_t length = static_cast<uint64_t>(left.size()) + right.size();
+    if (length > UINT32_MAX)
+        throw ScriptError("[ERROR] String too long.\n");
+    if (length <= Value::SMALL_MAX) {
+        char text[Value::SMALL_MAX];
+        std::memcpy(text, left.data(), left.size());
+        std::memcpy(text + left.size(), right.data(), right.size());
+        return Value::string(std::string_view(text, length));
+    }
+
+    // nobody has appended past a's end yet, so b can go right after it
+    if (a.bytes[0] == Value::STR_HEAP) {
+        StrBuf* buf = a.heap();
+        if (buf->used == left.size() && buf->capacity >= length) {
+            std::memcpy(buf->data() + buf->used, right.data(), right.size());
+            buf->used = static_cast<uint32_t>(length);
+            return Value::heapString(buf, buf->used);
+        }
+    }
+
+    // a fresh buffer. if a was already being built up, leave room to keep going
+    uint64_t capacity = length;
+    if (a.bytes[0] == Value::STR_HEAP && a.heap()->used == left.size())
+        capacity = std::min<uint64_t>(length * 2, UINT32_MAX);
+
+    StrBuf* buf = Value::allocate(static_cast<uint32_t>(capacity));
+    std::memcpy(buf->data(), left.data(), left.size());
+    std::memcpy(buf->data() + left.size(), right.data(), right.size());
+    buf->used = static_cast<uint32_t>(length);
+    return Value::heapString(buf, buf->used);
+}
+
+// helpers
+
+std::string valueToString(const Value& v) {
+    switch (v.type()) {
+        case ValueType::Int:    return std::to_string(v.asInt());
+        case ValueType::Bool:   return v.asBool() ? "true" : "false";
+        case ValueType::String: return std::string(v.asString());
+        case ValueType::Char:   return std::string(1, v.asChar());
+        case ValueType::Null:   return "null";
+    }
+    return "null";
+}
+
+bool valueMatchesType(TokenType declared, const Value& v) {
+    switch (declared) {
+        case TYPE_INT:    return v.isInt();
+        case TYPE_STRING: return v.isString();
+        case TYPE_BOOL:   return v.isBool();
+        case TYPE_CHAR:   return v.isChar();
+        default:          return false;
+    }
+}
@@ -0,0 +1,192 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "interpreter/token.h"
+#include "interpreter/interner.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+enum class ValueType : uint8_t {
+    Null, Int, Bool, Char, String,
+};
+
+// a runtime string buffer, shared by every Value copy that points at it.
+// the text follows the header in the same allocation.
+//
+// it doubles as a string builder: each Value sees only a prefix of the
+// buffer (its own length), so a + b can write b straight after a in the
+// spare capacity, as long as nobody has appended past a yet. that keeps
+// s = s + piece; in a loop linear instead of copying s every time, and the
+// text is always flat so reading it never has to stitch anything together.
+struct StrBuf {
+    uint32_t refs;
+    uint32_t used;      // bytes written so far, the longest prefix anyone sees
+    uint32_t capacity;
+    uint32_t unused;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+// 16 bytes, every kind of value is stored inline:
+//
+//   byte 0      tag
+//   int/bool/char   payload in bytes 8..11
+//   small string    length in byte 1, up to 14 chars in bytes 2..15
+//   interned string symbol in bytes 4..7, pointer to the interner's text in 8..15
+//   heap string     length in bytes 4..7, pointer to a refcounted StrBuf in 8..15
+//
+// strings are immutable, so copying one is at most a refcount bump and
+// never allocates. the bytes are only ever touched through memcpy, which
+// compiles down to plain loads and stores.
+class Value {
+    public:
+        static constexpr size_t SMALL_MAX = 14;
+
+        Value() { bytes[0] = NIL; }
+        Value(int i)  { bytes[0] = INT;  put(8, static_cast<int32_t>(i)); }
+        Value(bool b) { bytes[0] = BOOL; bytes[8] = b; }
+        Value(char c) { bytes[0] = CHAR; bytes[8] = static_cast<unsigned char>(c); }
+        Value(const char*) = delete; // would quietly turn into a bool
+
+        // a string the interner owns, compared by symbol
+        static Value interned(const Interner& interner, Symbol symbol);
+        // same, for text laid out the way the interner does it (length in the
+        // four bytes in front) somewhere else, like a mapped .zenc file
+        static Value interned(Symbol symbol, const char* text);
+        // any other string, inlined when it's short enough
+        static Value string(std::string_view text);
+
+        Value(const Value& other) {
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            retain();
+        }
+        Value(Value&& other) noexcept {
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            other.bytes[0] = NIL;
+        }
+        Value& operator=(const Value& other) {
+            if (this != &other) {
+                other.retain();
+                release();
+                std::memcpy(bytes, other.bytes, sizeof(bytes));
+            }
+            return *this;
+        }
+        Value& operator=(Value&& other) noexcept {
+            if (this != &other) {
+                release();
+                std::memcpy(bytes, other.bytes, sizeof(bytes));
+                other.bytes[0] = NIL;
+            }
+            return *this;
+        }
+        ~Value() { release(); }
+
+        // overwriting with an immediate skips building a temporary Value
+        Value& operator=(int i)  { release(); bytes[0] = INT;  put(8, static_cast<int32_t>(i)); return *this; }
+        Value& operator=(bool b) { release(); bytes[0] = BOOL; bytes[8] = b; return *this; }
+
+        ValueType type() const {
+            switch (bytes[0]) {
+                case INT:  return ValueType::Int;
+                case BOOL: return ValueType::Bool;
+                case CHAR: return ValueType::Char;
+                case NIL:  return ValueType::Null;
+                default:   return ValueType::String;
+            }
+        }
+
+        bool isNull() const   { return bytes[0] == NIL; }
+        bool isInt() const    { return bytes[0] == INT; }
+        bool isBool() const   { return bytes[0] == BOOL; }
+        bool isChar() const   { return bytes[0] == CHAR; }
+        bool isString() const { return bytes[0] >= STR_SMALL; }
+
+        int asInt() const   { return get<int32_t>(8); }
+        bool asBool() const { return bytes[8] != 0; }
+        char asChar() const { return static_cast<char>(bytes[8]); }
+        std::string_view asString() const;
+
+        // NO_SYMBOL unless this is an interned string
+        Symbol symbol() const { return bytes[0] == STR_INTERNED ? get<uint32_t>(4) : NO_SYMBOL; }
+
+        friend bool operator==(const Value& a, const Value& b);
+        friend bool operator!=(const Value& a, const Value& b) { return !(a == b); }
+        // native loops read tags and payloads straight out of the frame
+        friend class Jit;
+
+    private:
+        enum Tag : unsigned char {
+            NIL, INT, BOOL, CHAR,
+            // everything from here on is a string
+            STR_SMALL, STR_INTERNED, STR_HEAP,
+        };
+
+        alignas(8) unsigned char bytes[16] = {};
+
+        template <typename T>
+        T get(size_t offset) const {
+            T v;
+            std::memcpy(&v, bytes + offset, sizeof(T));
+            return v;
+        }
+        template <typename T>
+        void put(size_t offset, T v) {
+            std::memcpy(bytes + offset, &v, sizeof(T));
+        }
+
+        StrBuf* heap() const { return get<StrBuf*>(8); }
+
+        void retain() const {
+            if (bytes[0] == STR_HEAP) heap()->refs++;
+        }
+        void release() {
+            if (bytes[0] == STR_HEAP && --heap()->refs == 0) freeHeap();
+        }
+        void freeHeap();
+
+        static StrBuf* allocate(uint32_t capacity);
+        static Value heapString(StrBuf* buf, uint32_t length);
+
+        friend Value concat(const Value& a, const Value& b);
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay two words");
+
+Value concat(const Value& a, const Value& b);
+
+// heap string buffers allocated by this thread, for --stats
+struct StringStats {
+    uint64_t buffers = 0;
+    uint64_t bytes = 0;
+};
+const StringStats& stringStats();
+
+std::string valueToString(const Value& v);
+
+// does v hold the type a declaration spelled out (int, string, bool, char)
+bool valueMatchesType(TokenType declared, const Value& v);
+
+inline bool isTruthy(const Value& v) {
+    if (v.isBool()) return v.asBool();
+    if (v.isNull()) return false;
+    return true;  // everything else is truthy
+}
+
+inline bool isEqual(const Value& a, const Value& b) {
+    return a == b;
+}
+
+// int arithmetic wraps around on overflow instead of being undefined, and
+// INT_MIN / -1 wraps back to INT_MIN. the vm, the tree walker, the jit and
+// --emit-cpp's runtime all agree on this. divideInt's caller checks for 0
+inline int addInt(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b)); }
+inline int subtractInt(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b)); }
+inline int multiplyInt(int a, int b) { return static_cast<int>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b)); }
+inline int negateInt(int a) { return static_cast<int>(0u - static_cast<uint32_t>(a)); }
+inline int divideInt(int a, int b) { return b == -1 ? negateInt(a) : a / b; }
+
+#endif
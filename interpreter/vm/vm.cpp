@@ -0,0 +1,365 @@
+#include "vm.h"
+#include "interpreter/error.h"
+
+void VM::typeError(const std::string& msg, int line) {
+    throw ScriptError("[line " + std::to_string(line) + "] TYPE ERROR: " + msg + "\n");
+}
+
+void VM::interrupted(int line) {
+    throw ScriptError("[line " + std::to_string(line) + "] ERROR: Interrupted.\n");
+}
+
+namespace {
+
+// the comparison a fused compare-and-jump stands for, any of OP_GREATER to
+// OP_NOT_EQUAL or their _INT versions. 1 or 0, or -1 when a checked ordering
+// is handed something not an int
+inline int compare(uint8_t cmp, const Value& a, const Value& b) {
+    switch (cmp) {
+        case OP_EQUAL:             return isEqual(a, b);
+        case OP_NOT_EQUAL:         return !isEqual(a, b);
+        case OP_GREATER_INT:       return a.asInt() > b.asInt();
+        case OP_GREATER_EQUAL_INT: return a.asInt() >= b.asInt();
+        case OP_LESS_INT:          return a.asInt() < b.asInt();
+        case OP_LESS_EQUAL_INT:    return a.asInt() <= b.asInt();
+        default:                   break;
+    }
+    if (!a.isInt() || !b.isInt()) return -1;
+    int x = a.asInt();
+    int y = b.asInt();
+    switch (cmp) {
+        case OP_GREATER:       return x > y;
+        case OP_GREATER_EQUAL: return x >= y;
+        case OP_LESS:          return x < y;
+        default:               return x <= y;
+    }
+}
+
+const char* compareSymbol(uint8_t cmp) {
+    switch (cmp) {
+        case OP_GREATER:       return ">";
+        case OP_GREATER_EQUAL: return ">=";
+        case OP_LESS:          return "<";
+        default:               return "<=";
+    }
+}
+
+} // namespace
+
+// -pedantic complains about label addresses and goto *, they're the point here
+#ifdef ZENITH_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#ifdef ZENITH_JIT
+// OP_LOOP with the jit on, ip is just past the opcode. kept out of run so
+// the interpreter's own registers don't suffer for it
+const uint8_t* VM::loop(Jit& jit, const ChunkView& chunk, const uint8_t* ip, Value* locals) {
+    uint32_t target = readOperand(ip);
+    uint32_t number = readOperand(ip + 4);
+    if (jit.hot(number)) {
+        uint32_t end = static_cast<uint32_t>(ip + 8 - chunk.code);
+        uint32_t fault;
+        switch (jit.run(chunk, number, target, end, locals, fault)) {
+            case Jit::Exit::Finished:
+                return chunk.code + end;
+            case Jit::Exit::DivideByZero:
+                typeError("Division by zero.", chunk.lineAt(fault));
+            case Jit::Exit::Interrupted:
+                interrupted(chunk.lineAt(static_cast<size_t>(ip - 1 - chunk.code)));
+            case Jit::Exit::Interpret:
+                break;
+        }
+    }
+    return chunk.code + target;
+}
+#endif
+
+void VM::run(const ChunkView& chunk, Value* globals, size_t globalCount) {
+    std::vector<Value> stack(chunk.maxStack + 1);
+    Value* sp = stack.data();
+    std::vector<Value> frame(chunk.maxLocals);
+    Value* locals = frame.data();
+    for (size_t i = 0; i < globalCount; i++) locals[i] = std::move(globals[i]);
+
+    const uint8_t* code = chunk.code;
+    const uint8_t* ip = code;
+    const std::atomic<bool>* stop = interrupt;
+#ifdef ZENITH_JIT
+    Jit jit(stop);
+#endif
+
+// operands sit right after the opcode, ip is already past the opcode byte
+#define READ_OPERAND() (ip += 4, readOperand(ip - 4))
+// line of the instruction that started opSize bytes before ip
+#define LINE(opSize) chunk.lineAt(static_cast<size_t>(ip - code) - (opSize))
+
+#define INT_OPERANDS(symbol)                                                       \
+    if (!sp[-2].isInt() || !sp[-1].isInt()) \
+        typeError("Operands of '" symbol "' must be int.", LINE(1));
+
+// a fused compare's result, jumps to target when it came out false
+#define COMPARE_JUMP(cmp, a, b, target, opSize)                                       \
+    switch (compare(cmp, a, b)) {                                                    \
+        case 0:  ip = code + (target); break;                                        \
+        case 1:  break;                                                              \
+        default: typeError(std::string("Operands of '") + compareSymbol(cmp)         \
+                           + "' must be int.", LINE(opSize));                        \
+    }
+
+#define UNCHECKED_BINARY(op)                      \
+    sp[-2] = sp[-2].asInt() op sp[-1].asInt();      \
+    sp--;
+
+#define INT_BINARY(symbol, op)                                    \
+    INT_OPERANDS(symbol)                                          \
+    UNCHECKED_BINARY(op)
+
+// arithmetic goes through value.h's wrapping helpers
+#define UNCHECKED_ARITHMETIC(fn)                  \
+    sp[-2] = fn(sp[-2].asInt(), sp[-1].asInt());    \
+    sp--;
+
+#define INT_ARITHMETIC(symbol, fn)                                \
+    INT_OPERANDS(symbol)                                          \
+    UNCHECKED_ARITHMETIC(fn)
+
+#ifdef ZENITH_COMPUTED_GOTO
+    static const void* dispatchTable[] = {
+        &&do_OP_CONSTANT, &&do_OP_NIL, &&do_OP_TRUE, &&do_OP_FALSE, &&do_OP_POP,
+        &&do_OP_DEFINE_LOCAL, &&do_OP_STORE_LOCAL, &&do_OP_GET_LOCAL, &&do_OP_SET_LOCAL,
+        &&do_OP_ADD, &&do_OP_SUBTRACT, &&do_OP_MULTIPLY, &&do_OP_DIVIDE,
+        &&do_OP_GREATER, &&do_OP_GREATER_EQUAL, &&do_OP_LESS, &&do_OP_LESS_EQUAL,
+        &&do_OP_EQUAL, &&do_OP_NOT_EQUAL,
+        &&do_OP_NEGATE, &&do_OP_NOT,
+        &&do_OP_ADD_INT, &&do_OP_SUBTRACT_INT, &&do_OP_MULTIPLY_INT, &&do_OP_DIVIDE_INT,
+        &&do_OP_GREATER_INT, &&do_OP_GREATER_EQUAL_INT, &&do_OP_LESS_INT, &&do_OP_LESS_EQUAL_INT,
+        &&do_OP_NEGATE_INT, &&do_OP_CONCAT,
+        &&do_OP_PRINT,
+        &&do_OP_JUMP, &&do_OP_LOOP, &&do_OP_JUMP_IF_FALSE, &&do_OP_JUMP_IF_FALSE_OR_POP, &&do_OP_JUMP_IF_TRUE_OR_POP,
+        &&do_OP_ADD_LOCAL_CONST, &&do_OP_COMPARE_JUMP, &&do_OP_LOCAL_CONST_COMPARE_JUMP, &&do_OP_LOCALS_COMPARE_JUMP,
+        &&do_OP_MARK,
+        &&do_OP_HALT,
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == OP_COUNT_,
+                  "dispatch table out of sync with OpCode");
+
+#define CASE(op) do_##op:
+#define DISPATCH() goto *dispatchTable[*ip++]
+
+    DISPATCH();
+    {
+#else
+#define CASE(op) case op:
+#define DISPATCH() continue
+
+    for (;;) switch (*ip++) {
+#endif
+
+        CASE(OP_CONSTANT) {
+            *sp++ = chunk.constants[READ_OPERAND()];
+            DISPATCH();
+        }
+        CASE(OP_NIL)   { *sp++ = Value(); DISPATCH(); }
+        CASE(OP_TRUE)  { *sp++ = true;  DISPATCH(); }
+        CASE(OP_FALSE) { *sp++ = false; DISPATCH(); }
+        CASE(OP_POP)   { sp--; DISPATCH(); }
+
+        CASE(OP_DEFINE_LOCAL) {
+            uint32_t slot = READ_OPERAND();
+            TokenType declared = static_cast<TokenType>(*ip++);
+            if (!valueMatchesType(declared, sp[-1]))
+                typeError("Type mismatch in variable declaration.", LINE(6));
+            locals[slot] = std::move(*--sp);
+            DISPATCH();
+        }
+        CASE(OP_STORE_LOCAL) {
+            locals[READ_OPERAND()] = std::move(*--sp);
+            DISPATCH();
+        }
+        CASE(OP_GET_LOCAL) {
+            *sp++ = locals[READ_OPERAND()];
+            DISPATCH();
+        }
+        CASE(OP_SET_LOCAL) {
+            locals[READ_OPERAND()] = sp[-1];
+            DISPATCH();
+        }
+
+        CASE(OP_ADD) {
+            Value& a = sp[-2];
+            Value& b = sp[-1];
+            if (a.isInt() && b.isInt()) {
+                a = addInt(a.asInt(), b.asInt());
+            } else if (a.isString() && b.isString()) {
+                a = concat(a, b);
+            } else {
+                typeError("Operands of '+' must both be int or both be string.", LINE(1));
+            }
+            sp--;
+            DISPATCH();
+        }
+
+        CASE(OP_SUBTRACT) { INT_ARITHMETIC("-", subtractInt) DISPATCH(); }
+        CASE(OP_MULTIPLY) { INT_ARITHMETIC("*", multiplyInt) DISPATCH(); }
+
+        CASE(OP_DIVIDE) {
+            INT_OPERANDS("/")
+            if (sp[-1].asInt() == 0)
+                typeError("Division by zero.", LINE(1));
+            UNCHECKED_ARITHMETIC(divideInt)
+            DISPATCH();
+        }
+
+        CASE(OP_GREATER)       { INT_BINARY(">", >)   DISPATCH(); }
+        CASE(OP_GREATER_EQUAL) { INT_BINARY(">=", >=) DISPATCH(); }
+        CASE(OP_LESS)          { INT_BINARY("<", <)   DISPATCH(); }
+        CASE(OP_LESS_EQUAL)    { INT_BINARY("<=", <=) DISPATCH(); }
+
+        CASE(OP_EQUAL) {
+            sp[-2] = isEqual(sp[-2], sp[-1]);
+            sp--;
+            DISPATCH();
+        }
+        CASE(OP_NOT_EQUAL) {
+            sp[-2] = !isEqual(sp[-2], sp[-1]);
+            sp--;
+            DISPATCH();
+        }
+
+        CASE(OP_NEGATE) {
+            if (!sp[-1].isInt())
+                typeError("Operand of '-' must be an int.", LINE(1));
+            sp[-1] = negateInt(sp[-1].asInt());
+            DISPATCH();
+        }
+        CASE(OP_NOT) {
+            sp[-1] = !isTruthy(sp[-1]);
+            DISPATCH();
+        }
+
+        // the checker already knows these are ints
+        CASE(OP_ADD_INT)           { UNCHECKED_ARITHMETIC(addInt)      DISPATCH(); }
+        CASE(OP_SUBTRACT_INT)      { UNCHECKED_ARITHMETIC(subtractInt) DISPATCH(); }
+        CASE(OP_MULTIPLY_INT)      { UNCHECKED_ARITHMETIC(multiplyInt) DISPATCH(); }
+        CASE(OP_DIVIDE_INT) {
+            if (sp[-1].asInt() == 0)
+                typeError("Division by zero.", LINE(1));
+            UNCHECKED_ARITHMETIC(divideInt)
+            DISPATCH();
+        }
+        CASE(OP_GREATER_INT)       { UNCHECKED_BINARY(>)  DISPATCH(); }
+        CASE(OP_GREATER_EQUAL_INT) { UNCHECKED_BINARY(>=) DISPATCH(); }
+        CASE(OP_LESS_INT)          { UNCHECKED_BINARY(<)  DISPATCH(); }
+        CASE(OP_LESS_EQUAL_INT)    { UNCHECKED_BINARY(<=) DISPATCH(); }
+        CASE(OP_NEGATE_INT) {
+            sp[-1] = negateInt(sp[-1].asInt());
+            DISPATCH();
+        }
+        CASE(OP_CONCAT) {
+            sp[-2] = concat(sp[-2], sp[-1]);
+            sp--;
+            DISPATCH();
+        }
+
+        CASE(OP_PRINT) {
+            out.display(*--sp);
+            DISPATCH();
+        }
+
+        CASE(OP_JUMP) {
+            ip = code + readOperand(ip);
+            DISPATCH();
+        }
+        CASE(OP_LOOP) {
+            if (stop && stop->load(std::memory_order_relaxed)) interrupted(LINE(1));
+#ifdef ZENITH_JIT
+            if (useJit) {
+                ip = loop(jit, chunk, ip, locals);
+                DISPATCH();
+            }
+#endif
+            ip = code + readOperand(ip);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_FALSE) {
+            uint32_t target = READ_OPERAND();
+            if (!isTruthy(*--sp)) ip = code + target;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_FALSE_OR_POP) {
+            uint32_t target = READ_OPERAND();
+            if (!isTruthy(sp[-1])) ip = code + target;
+            else sp--;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_TRUE_OR_POP) {
+            uint32_t target = READ_OPERAND();
+            if (isTruthy(sp[-1])) ip = code + target;
+            else sp--;
+            DISPATCH();
+        }
+
+        CASE(OP_ADD_LOCAL_CONST) {
+            Value& x = locals[READ_OPERAND()];
+            const Value& c = chunk.constants[READ_OPERAND()];
+            x = addInt(x.asInt(), c.asInt());
+            DISPATCH();
+        }
+        CASE(OP_COMPARE_JUMP) {
+            uint8_t cmp = *ip++;
+            uint32_t target = READ_OPERAND();
+            sp -= 2;
+            COMPARE_JUMP(cmp, sp[0], sp[1], target, 6)
+            DISPATCH();
+        }
+        CASE(OP_LOCAL_CONST_COMPARE_JUMP) {
+            uint8_t cmp = *ip++;
+            const Value& a = locals[READ_OPERAND()];
+            const Value& b = chunk.constants[READ_OPERAND()];
+            uint32_t target = READ_OPERAND();
+            COMPARE_JUMP(cmp, a, b, target, 14)
+            DISPATCH();
+        }
+        CASE(OP_LOCALS_COMPARE_JUMP) {
+            uint8_t cmp = *ip++;
+            const Value& a = locals[READ_OPERAND()];
+            const Value& b = locals[READ_OPERAND()];
+            uint32_t target = READ_OPERAND();
+            COMPARE_JUMP(cmp, a, b, target, 14)
+            DISPATCH();
+        }
+
+        CASE(OP_MARK) {
+            uint32_t index = READ_OPERAND();
+            if (tracer) tracer->mark(index);
+            DISPATCH();
+        }
+
+        CASE(OP_HALT) {
+            for (size_t i = 0; i < globalCount; i++) globals[i] = std::move(locals[i]);
+            return;
+        }
+
+#ifndef ZENITH_COMPUTED_GOTO
+        default:
+            throw ScriptError("[ERROR] Unknown opcode " + std::to_string(ip[-1]) + ".\n");
+#endif
+    }
+
+#undef READ_OPERAND
+#undef LINE
+#undef INT_OPERANDS
+#undef INT_BINARY
+#undef UNCHECKED_BINARY
+#undef INT_ARITHMETIC
+#undef UNCHECKED_ARITHMETIC
+#undef COMPARE_JUMP
+#undef CASE
+#undef DISPATCH
+}
+
+#ifdef ZENITH_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,48 @@
+#ifndef VM_H
+#define VM_H
+
+#include "interpreter/compiler/chunk.h"
+#include "interpreter/output.h"
+#include "interpreter/jit/jit.h"
+#include "interpreter/profiler/trace.h"
+#include <atomic>
+#include <string>
+
+// computed goto is a gcc/clang extension, everyone else gets the switch.
+// define ZENITH_NO_COMPUTED_GOTO to force the switch anyway
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZENITH_NO_COMPUTED_GOTO)
+#define ZENITH_COMPUTED_GOTO 1
+#endif
+
+class VM {
+    public:
+        explicit VM(Output& out = standardOutput()) : out(out) {}
+
+        void run(const Chunk& chunk) { run(chunk.view()); }
+        // the code doesn't have to live in a Chunk, a mapped .zenc works too.
+        // the first globalCount frame slots start out as globals, and what
+        // the program left in them is moved back when it halts
+        void run(const ChunkView& chunk, Value* globals = nullptr, size_t globalCount = 0);
+
+        // where OP_MARK reports to, the compiler only emits it for --trace
+        void setTracer(Tracer* t) { tracer = t; }
+        // hot loops run as native code where there's a jit (jit.h), on by default
+        void setJit(bool on) { useJit = on; }
+        // checked on every trip round a loop, native ones included. once
+        // another thread sets it the program stops with an error
+        void setInterrupt(const std::atomic<bool>* flag) { interrupt = flag; }
+
+    private:
+        Output& out;
+        Tracer* tracer = nullptr;
+        bool useJit = true;
+        const std::atomic<bool>* interrupt = nullptr;
+
+        [[noreturn]] void typeError(const std::string& msg, int line);
+        [[noreturn]] void interrupted(int line);
+#ifdef ZENITH_JIT
+        [[gnu::noinline]] const uint8_t* loop(Jit& jit, const ChunkView& chunk, const uint8_t* ip, Value* locals);
+#endif
+};
+
+#endif
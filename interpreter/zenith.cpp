@@ -0,0 +1,125 @@
+#include "zenith.h"
+#include "interpreter/lexer/lexer.h"
+#include "interpreter/parser/parser.h"
+#include "interpreter/resolver/resolver.h"
+#include "interpreter/checker/checker.h"
+#include "interpreter/folder/folder.h"
+#include "interpreter/compiler/compiler.h"
+#include "interpreter/vm/vm.h"
+#include "interpreter/output.h"
+#include "interpreter/error.h"
+
+namespace zenith {
+
+// everything a run reads and nothing it writes. string constants point into
+// the interner, which is why the two travel together
+struct Program::Compiled {
+    Interner interner;
+    Chunk chunk;
+    // in slot order, the first frame slots belong to them
+    std::vector<std::string> hostVariables;
+};
+
+namespace {
+
+::Value toValue(const Variable& v) {
+    switch (v.index()) {
+        case 1:  return ::Value(std::get<int>(v));
+        case 2:  return ::Value(std::get<bool>(v));
+        case 3:  return ::Value(std::get<char>(v));
+        case 4:  return ::Value::string(std::get<std::string>(v));
+        default: return ::Value();
+    }
+}
+
+Variable toVariable(const ::Value& v) {
+    switch (v.type()) {
+        case ValueType::Int:    return v.asInt();
+        case ValueType::Bool:   return v.asBool();
+        case ValueType::Char:   return v.asChar();
+        case ValueType::String: return std::string(v.asString());
+        default:                return std::monostate();
+    }
+}
+
+} // namespace
+
+const Variable& Context::get(const std::string& name) const {
+    static const Variable null;
+    auto it = variables.find(name);
+    return it == variables.end() ? null : it->second;
+}
+
+Program compile(std::string_view source, const std::vector<std::string>& hostVariables) {
+    auto compiled = std::make_shared<Program::Compiled>();
+    Program program;
+    try {
+        Interner& interner = compiled->interner;
+        std::vector<Symbol> predeclared;
+        for (const std::string& name : hostVariables) {
+            Symbol symbol = interner.intern(name);
+            for (Symbol seen : predeclared) {
+                if (seen == symbol)
+                    throw ScriptError("[ERROR] Host variable '" + name + "' given twice.\n");
+            }
+            predeclared.push_back(symbol);
+        }
+
+        Lexer lexer(source, interner);
+        TokenStream tokens(lexer);
+        Ast ast = Parser(tokens, interner).parse();
+        int globals = Resolver().resolve(ast, predeclared);
+        Checker().check(ast, globals);
+        Folder(interner).fold(ast);
+        compiled->chunk = Compiler().compile(ast, globals);
+        compiled->hostVariables = hostVariables;
+    } catch (const ScriptError& e) {
+        program.report = e.what();
+        return program;
+    }
+
+    // runs on other threads copy these constants, which is only free of
+    // data races if none of them is a refcounted heap string. the folder
+    // and the lexer intern every string anyway, this just makes sure
+    for (::Value& constant : compiled->chunk.constants) {
+        if (constant.isString() && constant.symbol() == NO_SYMBOL)
+            constant = ::Value::interned(compiled->interner, compiled->interner.intern(constant.asString()));
+    }
+    program.compiled = std::move(compiled);
+    return program;
+}
+
+Result run(const Program& program, Context& context) {
+    Result result;
+    if (!program.ok()) {
+        result.ok = false;
+        result.error = program.report;
+        return result;
+    }
+    const Program::Compiled& compiled = *program.compiled;
+
+    std::vector<::Value> globals;
+    globals.reserve(compiled.hostVariables.size());
+    for (const std::string& name : compiled.hostVariables) globals.push_back(toValue(context.get(name)));
+
+    // without a callback display goes to stdout, but through an Output of
+    // its own, standardOutput() isn't safe to share between threads
+    auto out = context.output ? std::make_unique<Output>(context.output) : std::make_unique<Output>(1);
+    try {
+        VM vm(*out);
+        vm.setInterrupt(context.interrupt);
+        vm.run(compiled.chunk.view(), globals.data(), globals.size());
+        out->flush();
+    } catch (const ScriptError& e) {
+        out->flush();
+        result.ok = false;
+        result.error = e.what();
+        return result;
+    }
+
+    for (size_t i = 0; i < globals.size(); i++)
+        context.variables[compiled.hostVariables[i]] = toVariable(globals[i]);
+    return result;
+}
+
+} // namespace zenith